@@ -17,150 +17,826 @@
  * https://www.youtube.com/watch?v=C5-I0bAuEUE
  *
  * True value is about = 0.31182782
- * Obtained with WolframAlpha:
+ * Computed by the exact mode (simuBestop e), and matches WolframAlpha:
  * http://www.wolframalpha.com/input/?i=1+-+%28HarmonicNumber[100]+-+HarmonicNumber[50]%29
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <getopt.h>
+#include <stdatomic.h>
 #include <math.h>
+#include <limits.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
 
 #include <sys/mman.h>
 #include <sys/wait.h>
 
 #include "100prisoners.h"
+#include "exact/exact.h"
 
 #ifndef UNION
 #define UNION
 #include "union-find/union-find.h"
 #endif
 
-#ifdef PRNG
-
-#if PRNG == 1
-#include "MRG32k3a/MRG32k3a.h"
+// index in rng_backends of the PRNG used unless -g selects another one
+#ifndef PRNG
+#define PRNG 0
 #endif
 
-#if PRNG == 2
-#include "dSFMT/dSFMT.h"
-dsfmt_t dsfmt;
-#endif
+#define DEFAULT_NUM_PRISONERS 100
+#define DEFAULT_MAX_TRIALS 50
+#define MAX_SIMULATED_PRISONERS 100000000 // keeps every index of the batch engine in an int
+#define THRESHOLD_TABLE_SIZE 1024 // bounds up to this get their rejection threshold precomputed
+#define HARMONIC_TABLE_SIZE 4096 // harmonic numbers up to this are precomputed for the covariates
+#define MAX_CONDITIONAL_PRISONERS 100000000 // successTable of -r takes 8 bytes per prisoner
+#define MAX_TILTED_PRISONERS 10000000 // the tables of -e tilted take 24 bytes per prisoner
+#define MAX_HISTOGRAM_PRISONERS 1000000 // the histograms of --histogram take 16 bytes per prisoner and worker
+#define MAX_EXACT_HISTOGRAM_PRISONERS 10000 // printHistogram computes the exact probability of every length up to this
+#define STEAL_CHUNK 256 // simulations taken at once from a work stealing range, a multiple of BATCH_LANES
+#define MIN_SEQUENTIAL_SIMULATIONS 10000 // simulations before the stopping rule of --target-halfwidth is first checked
+#define DEBUG 0
+#define KERNEL_INLINE inline __attribute__((always_inline)) // see the kernels below
 
-#if PRNG == 3
-#include "Lfib4/Lfib4.h"
-#endif
+// pairs of (number of prisoners, trial limit) that get kernels specialized at
+// compile time, any other pair runs the generic kernels
+#define SPECIALIZED_KERNELS(X) \
+    X(100, 50)                 \
+    X(1000, 500)               \
+    X(64, 32)
 
-#endif
+// simulation engine used by simulateAndStats, selected with -e on the command line
+static enum engine_t engine = UNION_FIND_ENGINE;
 
-#define DEFAULT_NUM_PRISONERS 100
-#define MAX_TRIALS 50
-#define MAX_uint32 ((1UL << (sizeof(unsigned int)*8)) - 1)
-#define DEBUG 0
+// number of prisoners and boxes each may open, selected with -n and -k on the command line
+static long long numPrisoners = DEFAULT_NUM_PRISONERS;
+static long long maxTrials = DEFAULT_MAX_TRIALS;
+
+// PRNG of every thread or process, selected with -g on the command line
+static const struct rng_backend* backend = &rng_backends[PRNG];
+
+// seed of the whole run, selected with -S or read from /dev/urandom
+static unsigned long long runSeed;
+static int runSeedGiven = 0;
+
+// half-width of the 95% CI to stop at, selected with --target-halfwidth,
+// 0 performs the number of simulations given on the command line
+static double targetHalfwidth = 0;
+
+// set with -c to estimate with the covariates of each simulation as control variates
+static int controlVariates = 0;
+
+// expected values of the covariates, see setCovariates
+static double covariateMeans[NUM_COVARIATES];
+
+// H(m) for m below HARMONIC_TABLE_SIZE, see harmonic
+static double harmonicTable[HARMONIC_TABLE_SIZE];
+
+// number of cycles sampled by each simulation with -r before it adds the
+// probability that the boxes left succeed, 0 without -r
+static int conditionalCycles = 0;
+
+// probability that a random permutation of m boxes has no cycle longer than
+// maxTrials, for m up to numPrisoners, computed once with -r
+static double* successTable;
 
+// tilt of the cycle lengths of -e tilted with m boxes left, see initTilted:
+// log x, x^maxTrials - 1, and the log of (x + x^2 + ... + x^maxTrials) / m
+static double* tiltLogX;
+static double* tiltPowerK;
+static double* tiltLogNorm;
 
-/* ignore enums for now
-enum PRNG_enum {
-    c_random,
-    MRG32k3a,
-    dSFMT
-};
-*/
+// strata of -e stratified, see initStrata: stratum h holds the permutations
+// whose first box is in a cycle of length [strataLow[h], strataLow[h + 1]),
+// with probability strataWeight[h]
+static int numStrata;
+static int strataLow[MAX_STRATA + 1];
+static double strataWeight[MAX_STRATA];
+
+// simulations [strataFirst[h], strataFirst[h + 1]) of the current round of
+// -e stratified sample stratum h, see simulateStratified
+static long long strataFirst[MAX_STRATA + 1];
+
+// HISTOGRAM_OUTPUT is set with --histogram and SWEEP_OUTPUT with --sweep,
+// both record the longest cycle of every simulation, see printHistograms
+#define HISTOGRAM_OUTPUT 1
+#define SWEEP_OUTPUT 2
+#define N_SWEEP_OUTPUT 4 // set with --n-sweep, counts the successes of every number of prisoners instead
+static int histogramMode = 0;
+
+// strategy of the prisoners of --strategy, or the one benchmarkStrategies is running
+static enum strategy_t strategy = CYCLE_STRATEGY;
+static const char* const strategyNames[NUM_STRATEGIES] = { "cycle", "random", "window", "custom" }; // in the order of enum strategy_t
+
+// numbers of prisoners of --n-sweep are the multiples of nSweepStep up to
+// numPrisoners, and numPrisoners itself, 0 without --n-sweep
+static int nSweepStep = 0;
+
+// evaluators of every permutation with --paired, none without
+static struct evaluator evaluators[MAX_EVALUATORS];
+static int numEvaluators = 0;
+
+// kernels for numPrisoners and maxTrials, selected once the options are parsed
+static struct kernels kernel;
+
+// word range % bound for every bound below THRESHOLD_TABLE_SIZE, see randomInt
+static unsigned int rejectionThreshold[THRESHOLD_TABLE_SIZE];
 
 int main(int argc, char* argv[]) {
-    if (argc == 3) {
-        int inputNumSimulations = atoi(argv[1]);
+    static const struct option longOptions[] = {
+        {"target-halfwidth", required_argument, NULL, 'w'},
+        {"paired", required_argument, NULL, 'P'},
+        {"histogram", no_argument, NULL, 'H'},
+        {"sweep", no_argument, NULL, 'K'},
+        {"n-sweep", required_argument, NULL, 'N'},
+        {"strategy", required_argument, NULL, 'T'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    int strategyGiven = 0;
+    while ((opt = getopt_long(argc, argv, "e:n:k:S:g:w:cr:P:HKN:T:", longOptions, NULL)) != -1) {
+        if (opt == 'e' && parseEngine(optarg, &engine) == 0) {
+            continue;
+        }
+        if (opt == 'n' && (numPrisoners = atoll(optarg)) > 0) {
+            continue;
+        }
+        if (opt == 'k' && (maxTrials = atoll(optarg)) > 0) {
+            continue;
+        }
+        if (opt == 'g' && (backend = rng_find_backend(optarg)) != NULL) {
+            continue;
+        }
+        if (opt == 'w' && (targetHalfwidth = atof(optarg)) > 0) {
+            continue;
+        }
+        if (opt == 'c') {
+            controlVariates = 1;
+            continue;
+        }
+        if (opt == 'r' && (conditionalCycles = atoi(optarg)) > 0) {
+            continue;
+        }
+        if (opt == 'P' && (numEvaluators = parseEvaluators(optarg, evaluators)) > 0) {
+            continue;
+        }
+        if (opt == 'H') {
+            histogramMode |= HISTOGRAM_OUTPUT;
+            continue;
+        }
+        if (opt == 'K') {
+            histogramMode |= SWEEP_OUTPUT;
+            continue;
+        }
+        if (opt == 'N' && (nSweepStep = atoi(optarg)) > 0) {
+            continue;
+        }
+        if (opt == 'T' && parseStrategy(optarg, &strategy) == 0) {
+            strategyGiven = 1;
+            continue;
+        }
+        if (opt == 'S') {
+            runSeed = strtoull(optarg, NULL, 0);
+            runSeedGiven = 1;
+            continue;
+        }
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    // shift the options away so that argv[1] is the number of simulations,
+    // or the mode with --target-halfwidth
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (argc == 2 && *argv[1] == 'e') { // exact probability, nothing to simulate
+        printExact(numPrisoners, maxTrials);
+        return EXIT_SUCCESS;
+    }
+    if (numPrisoners > MAX_SIMULATED_PRISONERS) {
+        fprintf(stderr, "Can simulate at most %d prisoners\n", MAX_SIMULATED_PRISONERS);
+        return EXIT_FAILURE;
+    }
+    if (maxTrials > numPrisoners) {
+        maxTrials = numPrisoners;
+    }
+    if (controlVariates && engine != CYCLE_WALK_ENGINE && engine != FELLER_ENGINE) {
+        fprintf(stderr, "Control variates need the cycle or feller engine (-e cycle or -e feller)\n");
+        return EXIT_FAILURE;
+    }
+    if (conditionalCycles > 0 && (engine != FELLER_ENGINE || controlVariates)) {
+        fprintf(stderr, "The conditional estimator needs the feller engine (-e feller), without -c\n");
+        return EXIT_FAILURE;
+    }
+    if (engine == TILTED_ENGINE && (controlVariates || targetHalfwidth > 0)) {
+        fprintf(stderr, "The tilted engine works without -c and --target-halfwidth\n");
+        return EXIT_FAILURE;
+    }
+    if (engine == STRATIFIED_ENGINE && targetHalfwidth > 0) {
+        fprintf(stderr, "The stratified engine works without --target-halfwidth\n");
+        return EXIT_FAILURE;
+    }
+    if (histogramMode) {
+        if ((engine != CYCLE_WALK_ENGINE && engine != FELLER_ENGINE) ||
+            controlVariates || conditionalCycles > 0 || targetHalfwidth > 0 || numEvaluators > 0) {
+            fprintf(stderr, "--histogram and --sweep need the cycle or feller engine (-e cycle or -e feller), "
+                            "without -c, -r, --target-halfwidth and --paired\n");
+            return EXIT_FAILURE;
+        }
+        if (numPrisoners > MAX_HISTOGRAM_PRISONERS) {
+            fprintf(stderr, "--histogram and --sweep work with at most %d prisoners\n", MAX_HISTOGRAM_PRISONERS);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nSweepStep > 0) {
+        if (engine != UNION_FIND_ENGINE || controlVariates || conditionalCycles > 0 || targetHalfwidth > 0 ||
+            numEvaluators > 0 || histogramMode) {
+            fprintf(stderr, "--n-sweep grows the permutations itself, without -e, -c, -r, --target-halfwidth, "
+                            "--paired, --histogram and --sweep\n");
+            return EXIT_FAILURE;
+        }
+        if (numPrisoners > MAX_HISTOGRAM_PRISONERS) {
+            fprintf(stderr, "--n-sweep works with at most %d prisoners\n", MAX_HISTOGRAM_PRISONERS);
+            return EXIT_FAILURE;
+        }
+        engine = RESTAURANT_ENGINE;
+        histogramMode = N_SWEEP_OUTPUT;
+    }
+    int benchmark = argc == 3 && *argv[2] == 'b'; // every strategy one after another, see benchmarkStrategies
+    if (strategyGiven || benchmark) {
+        if (engine != UNION_FIND_ENGINE || controlVariates || conditionalCycles > 0 || numEvaluators > 0 ||
+            histogramMode || (benchmark && targetHalfwidth > 0)) {
+            fprintf(stderr, "--strategy and the benchmark of the strategies shuffle the boxes themselves, "
+                            "without -e, -c, -r, --paired, --histogram, --sweep and --n-sweep\n");
+            return EXIT_FAILURE;
+        }
+        engine = STRATEGY_ENGINE;
+    }
+    if (numEvaluators > 0) {
+        if (engine != UNION_FIND_ENGINE || controlVariates || conditionalCycles > 0 || targetHalfwidth > 0) {
+            fprintf(stderr, "--paired shuffles the boxes itself, without -e, -c, -r and --target-halfwidth\n");
+            return EXIT_FAILURE;
+        }
+        engine = PAIRED_ENGINE;
+        for (int i=0; i<numEvaluators; i++) {
+            if (evaluators[i].limit == 0 || evaluators[i].limit > numPrisoners) {
+                evaluators[i].limit = evaluators[i].limit == 0 ? maxTrials : numPrisoners;
+            }
+        }
+    }
+    if (conditionalCycles > 0) {
+        initSuccessTable();
+    }
+    selectKernels(&kernel, numPrisoners, maxTrials, backend->wordRange);
+    initRandomInt();
+    initCovariates();
+    if (engine == TILTED_ENGINE) {
+        initTilted();
+    }
+    if (engine == STRATIFIED_ENGINE) {
+        initStrata();
+    }
+    if (!runSeedGiven) {
+        readUrandom(&runSeed, sizeof(runSeed));
+    }
+    printf("PRNG: %s\n", backend->name);
+    printf("Run seed: %llu (pass -S %llu to reproduce this run)\n", runSeed, runSeed);
+    fflush(stdout); // or the forked processes would print it again
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long performed = argc > 1 ? atoll(argv[1]) : 0;
+    if (targetHalfwidth > 0) { // the stopping rule picks the number of simulations
+        int numWorkers = argc == 3 ? atoi(argv[2]) : 1;
+        if (!(argc == 2 && *argv[1] == 's') &&
+            !(argc == 3 && (*argv[1] == 't' || *argv[1] == 'p') && numWorkers >= 1)) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        performed = simulateToHalfwidth(targetHalfwidth, *argv[1], numWorkers);
+    }
+    else if (engine == STRATIFIED_ENGINE) { // a pilot round, then the round it allocates
+        int numWorkers = argc == 4 ? atoi(argv[3]) : 1;
+        if (!(argc == 3 && *argv[2] == 's') &&
+            !(argc == 4 && (*argv[2] == 't' || *argv[2] == 'p') && numWorkers >= 1)) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+        simulateStratified(performed, *argv[2], numWorkers);
+    }
+    else if (benchmark) {
+        benchmarkStrategies(performed);
+    }
+    else if (argc == 3) {
+        long long inputNumSimulations = atoll(argv[1]);
         if (*argv[2] == 's') { // simulate sequentially
-            int sum = simulateAndStats(inputNumSimulations, "Sequence (Single Thread / Process)");
-            printStats(sum, inputNumSimulations, "Sequence (Single Thread / Process)");
+            struct tallies t;
+            long long* histogram = histogramMode ? malloc(sizeof(long long) * histogramSize()) : NULL;
+            if (histogramMode && histogram == NULL) {
+                perror("Couldn't allocate the histograms");
+                return EXIT_FAILURE;
+            }
+            long long sum = simulateAndStats(0, 0, inputNumSimulations, &t, histogram,
+                                             "Sequence (Single Thread / Process)");
+            printResults(sum, inputNumSimulations, &t, "Sequence (Single Thread / Process)");
+            if (histogramMode) {
+                printHistograms(histogram, inputNumSimulations);
+                free(histogram);
+            }
         }
         else {
             printUsage();
+            return EXIT_SUCCESS;
         }
     }
     else if (argc == 4) {
-        int inputNumSimulations = atoi(argv[1]);
+        long long inputNumSimulations = atoll(argv[1]);
         if (*argv[2] == 'p') { // simulate with processes
             int numProcesses = atoi(argv[3]);
             simulateAndStatsWithProcesses(inputNumSimulations, numProcesses);
         }
+        else if (*argv[2] == 't') { // simulate with threads
+            int numThreads = atoi(argv[3]);
+            if (numThreads < 1) {
+                printUsage();
+                return EXIT_FAILURE;
+            }
+            simulateAndStatsWithThreads(inputNumSimulations, numThreads);
+        }
         else {
             printUsage();
+            return EXIT_SUCCESS;
         }
     }
     else {
         printUsage();
+        return EXIT_SUCCESS;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!benchmark) { // benchmarkStrategies printed the throughput of each strategy instead
+        printThroughput(performed, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
     }
     return EXIT_SUCCESS;
 }
 
 void printUsage(void) {
     puts("Usage:\n"
-         "\tsimuBestop numSimulations processOrNot numProcess\n"
+         "\tsimuBestop [-e engine] [-g PRNG] [-n numPrisoners] [-k maxTrials] [-S seed] numSimulations processOrNot numProcess\n"
+         "\tsimuBestop [options] --target-halfwidth halfWidth processOrNot numProcess\n"
          "\teg. Simulate 1234 with 4 processes\n"
          "\tsimuBestop 1234 p 4\n"
+         "\teg. Simulate 1234 with 4 threads\n"
+         "\tsimuBestop 1234 t 4\n"
          "\teg. Simulate 1234 sequentially (1 process)\n"
-         "\tsimuBestop 1234 s");
+         "\tsimuBestop 1234 s\n"
+         "\tengine is union (union find, default), cycle (cycle walk)\n"
+         "\tbatch (union find on a batch of simulations at once)\n"
+         "\tfeller (cycle lengths sampled with the Feller coupling)\n"
+         "\ttilted (importance sampling of short cycles, for tiny probabilities)\n"
+         "\tor stratified (feller, stratified by the length of the first cycle)\n"
+         "\teg. Simulate 1234 sequentially with the cycle walk engine\n"
+         "\tsimuBestop -e cycle 1234 s\n"
+         "\teg. Simulate 1234 sequentially with 1000 prisoners opening 500 boxes each (default 100 and 50)\n"
+         "\tsimuBestop -n 1000 -k 500 1234 s\n"
+         "\tPRNG is random (default), mrg (MRG32k3a), dsfmt, lfib4 or philox\n"
+         "\teg. Simulate 1234 with 4 processes drawing from dSFMT\n"
+         "\tsimuBestop -g dsfmt 1234 p 4\n"
+         "\teg. Reproduce a run with seed 42\n"
+         "\tsimuBestop -S 42 1234 p 4\n"
+         "\teg. Simulate with 4 processes until the 95% CI half-width is at most 1e-4\n"
+         "\tsimuBestop --target-halfwidth 1e-4 p 4\n"
+         "\t(or --target-halfwidth 1e-4 s sequentially, --target-halfwidth 1e-4 t 4 with threads)\n"
+         "\teg. Simulate 1234 sequentially with the feller engine, and also estimate with control variates\n"
+         "\tsimuBestop -c -e feller 1234 s\n"
+         "\teg. Simulate 1234 sequentially with the feller engine, sampling only the first cycle\n"
+         "\tof each simulation and adding the probability that the boxes left succeed\n"
+         "\tsimuBestop -r 1 -e feller 1234 s\n"
+         "\teg. Estimate the tiny probability for 1000 prisoners opening 20 boxes each\n"
+         "\tsimuBestop -e tilted -n 1000 -k 20 1234 s\n"
+         "\teg. Simulate 100000 with 4 threads, stratified by the length of the first cycle\n"
+         "\tsimuBestop -e stratified 100000 t 4\n"
+         "\teg. Compare opening 45 boxes with opening 50 on the same 100000 permutations\n"
+         "\tsimuBestop --paired cycle,cycle:45 100000 s\n"
+         "\t(evaluators are cycle, naive or union, each with its own :maxTrials)\n"
+         "\teg. Simulate 1234 with 4 processes and print the histograms of the longest cycle\n"
+         "\tand of the number of cycles (with -e cycle or -e feller)\n"
+         "\tsimuBestop --histogram -e feller 1234 p 4\n"
+         "\teg. Estimate the success probability for every maxTrials from 1 to 100 in one run\n"
+         "\tsimuBestop --sweep -e feller 1234 s\n"
+         "\teg. Estimate the success probability of 10, 20, ..., 1000 prisoners opening half of the boxes\n"
+         "\tin one run, growing each permutation from 1 to 1000 prisoners\n"
+         "\tsimuBestop --n-sweep 10 -n 1000 -k 500 1234 t 4\n"
+         "\teg. Simulate 1234 with 4 threads, each prisoner opening 50 boxes at random\n"
+         "\tsimuBestop --strategy random 1234 t 4\n"
+         "\t(strategies are cycle, random, window or custom)\n"
+         "\teg. Benchmark every strategy on the same 1234 simulations\n"
+         "\tsimuBestop 1234 b\n"
+         "\teg. Compute the exact probability for 1000 prisoners opening 400 boxes\n"
+         "\tsimuBestop -n 1000 -k 400 e");
+}
+
+int parseEngine(const char* name, enum engine_t* e) {
+    if (strcmp(name, "union") == 0) {
+        *e = UNION_FIND_ENGINE;
+    }
+    else if (strcmp(name, "cycle") == 0) {
+        *e = CYCLE_WALK_ENGINE;
+    }
+    else if (strcmp(name, "batch") == 0) {
+#if defined(__AVX512F__) || defined(__AVX2__)
+        *e = BATCH_UNION_FIND_ENGINE;
+#else
+        *e = UNION_FIND_ENGINE; // one lane after another is slower than union find itself
+#endif
+    }
+    else if (strcmp(name, "feller") == 0) {
+        *e = FELLER_ENGINE;
+    }
+    else if (strcmp(name, "tilted") == 0) {
+        *e = TILTED_ENGINE;
+    }
+    else if (strcmp(name, "stratified") == 0) {
+        *e = STRATIFIED_ENGINE;
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
+int parseStrategy(const char* name, enum strategy_t* s) {
+    for (int i=0; i<NUM_STRATEGIES; i++) {
+        if (strcmp(name, strategyNames[i]) == 0) {
+            *s = i;
+            return 0;
+        }
+    }
+    return -1;
 }
 
-int simulateAndStats(int n, char* caller) {
-    int sum = 0;
+int parseEvaluators(const char* list, struct evaluator* e) {
+    int num = 0;
+    while (*list != '\0') {
+        if (num == MAX_EVALUATORS) {
+            return -1;
+        }
+        size_t length = strcspn(list, ":,");
+        if (length == 5 && strncmp(list, "cycle", 5) == 0) {
+            e[num].kind = CYCLE_EVALUATOR;
+        }
+        else if (length == 5 && strncmp(list, "naive", 5) == 0) {
+            e[num].kind = NAIVE_EVALUATOR;
+        }
+        else if (length == 5 && strncmp(list, "union", 5) == 0) {
+            e[num].kind = UNION_EVALUATOR;
+        }
+        else {
+            return -1;
+        }
+        list += length;
+        e[num].limit = 0;
+        if (*list == ':') {
+            char* end;
+            e[num].limit = strtoll(list + 1, &end, 10);
+            if (e[num].limit <= 0 || end == list + 1) {
+                return -1;
+            }
+            list = end;
+        }
+        num++;
+        if (*list == ',') {
+            list++;
+        }
+        else if (*list != '\0') {
+            return -1;
+        }
+    }
+    return num >= 2 ? num : -1;
+}
 
-    seed(); // seed to randomize boxes array in simulation
-    set_union s;
-    for (int i=0; i<n; i++) {
-        sum += runSimulation(&s); // simulation performed here
+long long simulateAndStats(int stream, long long first, long long n, struct tallies* t, long long* histogram,
+                           char* caller) {
+    struct workspace w;
+    workspace_init(&w, engine, numPrisoners);
+    seed(&w.rng, stream); // seed to randomize boxes array in simulation
+    long long sum = simulateRange(&w, first, n);
+    *t = w.tallies;
+    if (histogramMode) {
+        memcpy(histogram, w.histogram, sizeof(long long) * histogramSize());
     }
+    workspace_free(&w);
 #if DEBUG == 1
-    printStats(sum, n, caller);
+    printResults(sum, n, t, caller);
 #endif
     return sum;
 }
 
-enum found_t runSimulation(set_union* s) {
-    return single_simulation(s, DEFAULT_NUM_PRISONERS);
+long long simulateRange(struct workspace* w, long long first, long long n) {
+    long long sum = 0;
+    if (conditionalCycles > 0) { // only the feller engine, see main
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            double p = runFellerConditional(&w->rng);
+            moments_add(&w->tallies.conditional, p);
+        }
+    }
+    else if (histogramMode & HISTOGRAM_OUTPUT) { // only the cycle walk and feller engines, see main
+        long long* cycleCounts = w->histogram + numPrisoners + 1;
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            int longest;
+            int cycles = engine == CYCLE_WALK_ENGINE ?
+                         runCycleProfile(&w->rng, w->boxes, w->visited, &longest) :
+                         runFellerProfile(&w->rng, &longest);
+            w->histogram[longest]++;
+            cycleCounts[cycles]++;
+            sum += longest <= maxTrials;
+        }
+    }
+    else if (histogramMode & SWEEP_OUTPUT) { // --sweep alone needs the longest cycle only
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            int longest;
+            if (engine == CYCLE_WALK_ENGINE) {
+                runCycleLongest(&w->rng, w->boxes, w->visited, &longest);
+            }
+            else {
+                runFellerLongest(&w->rng, &longest);
+            }
+            w->histogram[longest]++;
+            sum += longest <= maxTrials;
+        }
+    }
+    else if (engine == STRATEGY_ENGINE) {
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            sum += runStrategySimulation(&w->rng, w->boxes, w->order); // every prisoner, until one fails
+        }
+    }
+    else if (engine == RESTAURANT_ENGINE) { // only with --n-sweep, see main
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            sum += runRestaurantSimulation(&w->rng, w->cycleOf, w->cycleLength, w->histogram);
+        }
+    }
+    else if (controlVariates) { // only the cycle walk and feller engines, see main
+        double x[NUM_COVARIATES];
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            enum found_t found = engine == CYCLE_WALK_ENGINE ?
+                                 runCycleSimulationWithCovariates(&w->rng, w->boxes, w->visited, x) :
+                                 runFellerSimulationWithCovariates(&w->rng, x);
+            covariate_sums_add(&w->tallies.cv, x, found);
+            sum += found;
+        }
+    }
+    else if (engine == CYCLE_WALK_ENGINE) {
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            sum += runCycleSimulation(&w->rng, w->boxes, w->visited); // simulation performed here
+        }
+    }
+    else if (engine == BATCH_UNION_FIND_ENGINE) {
+        long long i = 0;
+        for (; i + BATCH_LANES <= n; i += BATCH_LANES) {
+            seedSimulation(&w->rng, first + i); // the lanes share the stream of the first simulation
+            sum += runBatchSimulation(&w->rng, &w->batch); // BATCH_LANES simulations performed here
+        }
+        for (; i<n; i++) { // left over simulations that don't fill a batch
+            seedSimulation(&w->rng, first + i);
+            sum += runSimulation(&w->rng, &w->s);
+        }
+    }
+    else if (engine == FELLER_ENGINE) {
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            sum += runFellerSimulation(&w->rng); // simulation performed here
+        }
+    }
+    else if (engine == TILTED_ENGINE) {
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            tallies_add_weight(&w->tallies, runTiltedSimulation(&w->rng)); // every one succeeds
+        }
+        sum = n;
+    }
+    else if (engine == PAIRED_ENGINE) {
+        int y[MAX_EVALUATORS];
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            runPairedSimulation(&w->rng, w, y); // every evaluator judges the same permutation
+            paired_sums_add(&w->tallies.paired, y, numEvaluators);
+            sum += y[0];
+        }
+    }
+    else if (engine == STRATIFIED_ENGINE) {
+        int h = 0;
+        for (long long i=0; i<n; i++) {
+            while (first + i >= strataFirst[h + 1]) { // the simulations of a stratum are consecutive
+                h++;
+            }
+            seedSimulation(&w->rng, first + i);
+            enum found_t found = runStratifiedSimulation(&w->rng, strataLow[h], strataLow[h + 1] - strataLow[h]);
+            strata_sums_add(&w->tallies.strata, h, found);
+            sum += found;
+        }
+    }
+    else {
+        for (long long i=0; i<n; i++) {
+            seedSimulation(&w->rng, first + i);
+            sum += runSimulation(&w->rng, &w->s); // simulation performed here
+        }
+    }
+    return sum;
 }
 
-enum found_t runNaiveSimulation(void) {
-    const int num = DEFAULT_NUM_PRISONERS;
-    int prisoners[num];
-    int boxes[num];
-
-    for (int i=0; i<num; i++) {
-        prisoners[i] = i;
-        boxes[i] = i;
+void workspace_init(struct workspace* w, enum engine_t e, int size) {
+    size_t bytes = 0;
+    if (e == CYCLE_WALK_ENGINE || e == PAIRED_ENGINE) {
+        bytes += arena_size(sizeof(int) * size)
+               + arena_size(sizeof(unsigned long long) * ((size + 63) / 64));
+    }
+    if (e == STRATEGY_ENGINE) {
+        bytes += arena_size(sizeof(int) * size) + arena_size(sizeof(int) * 2 * size);
+    }
+    if (e == BATCH_UNION_FIND_ENGINE) {
+        bytes += 2 * arena_size(sizeof(int) * size * BATCH_LANES);
+    }
+    if (e == UNION_FIND_ENGINE || e == BATCH_UNION_FIND_ENGINE || e == PAIRED_ENGINE) {
+        bytes += 2 * arena_size(sizeof(int) * size);
+    }
+    if (e == RESTAURANT_ENGINE) {
+        bytes += 2 * arena_size(sizeof(int) * size);
+    }
+    if (histogramMode) {
+        bytes += arena_size(sizeof(long long) * histogramSize());
+    }
+    if (arena_init(&w->memory, bytes) == -1) {
+        perror("Couldn't allocate memory for the simulation");
+        exit(EXIT_FAILURE);
     }
 
-    randomizeArray(boxes, num);
+    tallies_init(&w->tallies);
 
-    for (int i=0; i<num; i++) {
-        // if one prisoner does not find his tag, then return NOT_FOUND = 0, since
-        // not all prisoners found their tag.
-        if (lookForTag(prisoners[i], boxes) == NOT_FOUND) {
-            return NOT_FOUND;
+    // arena_init reserved room for every buffer below, so none of them is NULL
+    w->boxes = NULL;
+    w->visited = NULL;
+    if (e == CYCLE_WALK_ENGINE || e == PAIRED_ENGINE) {
+        w->boxes = arena_alloc(&w->memory, sizeof(int) * size);
+        w->visited = arena_alloc(&w->memory, sizeof(unsigned long long) * ((size + 63) / 64));
+    }
+    if (e == BATCH_UNION_FIND_ENGINE) {
+        w->batch.p = arena_alloc(&w->memory, sizeof(int) * size * BATCH_LANES);
+        w->batch.size = arena_alloc(&w->memory, sizeof(int) * size * BATCH_LANES);
+    }
+    if (e == UNION_FIND_ENGINE || e == BATCH_UNION_FIND_ENGINE || e == PAIRED_ENGINE) {
+        w->s.p = arena_alloc(&w->memory, sizeof(int) * size);
+        w->s.size = arena_alloc(&w->memory, sizeof(int) * size);
+    }
+    w->order = NULL;
+    if (e == STRATEGY_ENGINE) {
+        w->boxes = arena_alloc(&w->memory, sizeof(int) * size);
+        w->order = arena_alloc(&w->memory, sizeof(int) * 2 * size);
+        for (int i=0; i<size; i++) {
+            w->order[i] = i; // random_search_kernel keeps it this way
         }
     }
-    // if all prisoners found their tag, then return FOUND = 1
-    return FOUND;
+    w->cycleOf = NULL;
+    w->cycleLength = NULL;
+    if (e == RESTAURANT_ENGINE) {
+        w->cycleOf = arena_alloc(&w->memory, sizeof(int) * size);
+        w->cycleLength = arena_alloc(&w->memory, sizeof(int) * size);
+    }
+    w->histogram = NULL;
+    if (histogramMode) {
+        w->histogram = arena_alloc(&w->memory, sizeof(long long) * histogramSize());
+        memset(w->histogram, 0, sizeof(long long) * histogramSize());
+    }
 }
 
-int lookForTag(int prisonerNum, int boxes[]) {
-    int currentNum = prisonerNum;
+void workspace_free(struct workspace* w) {
+    arena_free(&w->memory);
+}
 
-    // have the prisoner check each box
-    for (int trials=0; trials<MAX_TRIALS; trials++) {
-        if (prisonerNum == boxes[currentNum]) { // prisoner checks number inside box
-            return FOUND;
-        }
-        else {
-            currentNum = boxes[currentNum]; // use number in box to search for next box
+enum found_t runSimulation(struct rng* r, set_union* s) {
+    return kernel.union_find(r, s);
+}
+
+enum found_t runCycleSimulation(struct rng* r, int* boxes, unsigned long long* visited) {
+    return kernel.cycle_walk(r, boxes, visited);
+}
+
+int runBatchSimulation(struct rng* r, set_union_batch* s) {
+    return kernel.batch(r, s);
+}
+
+enum found_t runFellerSimulation(struct rng* r) {
+    return kernel.feller(r);
+}
+
+enum found_t runCycleSimulationWithCovariates(struct rng* r, int* boxes, unsigned long long* visited, double* x) {
+    return kernel.cycle_walk_covariates(r, boxes, visited, x);
+}
+
+enum found_t runFellerSimulationWithCovariates(struct rng* r, double* x) {
+    return kernel.feller_covariates(r, x);
+}
+
+double runFellerConditional(struct rng* r) {
+    return kernel.feller_conditional(r);
+}
+
+double runTiltedSimulation(struct rng* r) {
+    return kernel.tilted(r);
+}
+
+int runCycleProfile(struct rng* r, int* boxes, unsigned long long* visited, int* longest) {
+    return kernel.cycle_walk_profile(r, boxes, visited, longest);
+}
+
+int runFellerProfile(struct rng* r, int* longest) {
+    return kernel.feller_profile(r, longest);
+}
+
+int runCycleLongest(struct rng* r, int* boxes, unsigned long long* visited, int* longest) {
+    return kernel.cycle_walk_longest(r, boxes, visited, longest);
+}
+
+int runFellerLongest(struct rng* r, int* longest) {
+    return kernel.feller_longest(r, longest);
+}
+
+enum found_t runRestaurantSimulation(struct rng* r, int* cycleOf, int* cycleLength, long long* successes) {
+    return kernel.restaurant(r, cycleOf, cycleLength, successes);
+}
+
+enum found_t runStratifiedSimulation(struct rng* r, int low, int count) {
+    return kernel.stratified(r, low, count);
+}
+
+void moments_merge(struct moments* to, const struct moments* from) {
+    if (from->n == 0) {
+        return;
+    }
+    long long n = to->n + from->n;
+    double delta = from->mean - to->mean;
+    to->mean += delta * from->n / n;
+    to->m2 += from->m2 + delta * delta * ((double)to->n * from->n / n);
+    to->n = n;
+}
+
+void tallies_init(struct tallies* t) {
+    covariate_sums_init(&t->cv);
+    t->conditional = (struct moments){ 0, 0, 0 };
+    t->logScale = -INFINITY;
+    t->weights = 0;
+    t->weightSquares = 0;
+    strata_sums_init(&t->strata);
+    paired_sums_init(&t->paired);
+}
+
+// divides the weights of t by exp(logScale - t->logScale) more, logScale >= t->logScale
+static void rescaleWeights(struct tallies* t, double logScale) {
+    if (t->weights > 0) {
+        double f = exp(t->logScale - logScale);
+        t->weights *= f;
+        t->weightSquares *= f*f;
+    }
+    t->logScale = logScale;
+}
+
+void tallies_add_weight(struct tallies* t, double logRatio) {
+    if (logRatio > t->logScale) {
+        rescaleWeights(t, logRatio);
+    }
+    double w = exp(logRatio - t->logScale);
+    t->weights += w;
+    t->weightSquares += w*w;
+}
+
+void tallies_merge(struct tallies* to, const struct tallies* from) {
+    covariate_sums_merge(&to->cv, &from->cv);
+    moments_merge(&to->conditional, &from->conditional);
+    strata_sums_merge(&to->strata, &from->strata);
+    paired_sums_merge(&to->paired, &from->paired);
+    if (from->weights > 0) {
+        if (from->logScale > to->logScale) {
+            rescaleWeights(to, from->logScale);
         }
+        double f = exp(from->logScale - to->logScale);
+        to->weights += from->weights * f;
+        to->weightSquares += from->weightSquares * f*f;
     }
-    return NOT_FOUND; // exhausted all 50 boxes
 }
 
-void printStats(int sum, int n, char* caller) {
+enum found_t runStrategySimulation(struct rng* r, int* boxes, int* order) {
+    return kernel.strategy(r, boxes, order);
+}
+
+void printStats(long long sum, long long n, char* caller) {
     double mean = sum / (n + 0.0);
     // standard variance formula = ( sigmaSum(x^2) * n*mean^2 ) / (n - 1)
     // since sigmaSum(x^2) = sum because each simulation is a Bernoulli random variable,
@@ -168,113 +844,1180 @@ void printStats(int sum, int n, char* caller) {
     // variance = (sum * (n*sum^2)/n^2) / (n-1) = (sum * sum^2/n) / (n-1) = (sum*(1 - mean))/(n-1)
     double var = (sum*(1 - mean))/(n-1);
     printf("\nStatistics of %s:\n", caller);
-    printf("Number of simulations: %d\n", n);
+    printf("Number of simulations: %lld\n", n);
     printf("Parameter Estimate = %f\n", mean);
     printf("Variance is %f\n", var);
     printf("95%% CI: {%f, %f}\n",
            mean - 1.96*sqrt(var/n),
            mean + 1.96*sqrt(var/n));
-}
 
-enum found_t single_simulation(set_union* s, int size) {
-    int currentIndex = size - 1;
-    int randomIndex;
+    double truth = engine == STRATEGY_ENGINE ? strategyProbability(strategy) :
+                   exact_probability(numPrisoners, maxTrials);
+    if (!isnan(truth)) {
+        printf("Deviation from true value %.8f = %f (%.2f standard errors)\n",
+               truth, mean - truth, var > 0 ? (mean - truth) / sqrt(var/n) : 0);
+    }
+}
 
-    set_union_init(s, DEFAULT_NUM_PRISONERS);
-    while (currentIndex > 0) {
-        randomIndex = randomInt(currentIndex);
+double strategyProbability(enum strategy_t s) {
+    if (s == CYCLE_STRATEGY) {
+        return exact_probability(numPrisoners, maxTrials);
+    }
+    if (s == RANDOM_STRATEGY) { // each prisoner finds his tag with probability k/n, on his own
+        return pow(maxTrials / (double)numPrisoners, numPrisoners);
+    }
+    return NAN;
+}
 
-        union_set(s, currentIndex, randomIndex);
-        if (s->size[find(s, currentIndex)] > MAX_TRIALS) {
-            return NOT_FOUND;
-        }
+void benchmarkStrategies(long long n) {
+    for (int s=0; s<NUM_STRATEGIES; s++) {
+        strategy = s;
+        char caller[64];
+        snprintf(caller, sizeof(caller), "the %s strategy (Single Thread / Process)", strategyNames[s]);
 
-        currentIndex--;
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        struct tallies t;
+        long long sum = simulateAndStats(0, 0, n, &t, NULL, caller);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        printStats(sum, n, caller);
+        printThroughput(n, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
     }
-    return FOUND;
 }
 
-void randomizeArray(int* array, int size) {
-    int currentIndex = size - 1;
-    int randomIndex;
-    int toSwap;
+void printResults(long long sum, long long n, const struct tallies* t, char* caller) {
+    if (engine == TILTED_ENGINE) {
+        printImportance(n, t, caller);
+        return;
+    }
+    if (conditionalCycles > 0) {
+        printConditional(t, caller);
+        return;
+    }
+    if (engine == STRATIFIED_ENGINE) {
+        printStratified(t, n, caller);
+        return;
+    }
+    if (engine == PAIRED_ENGINE) {
+        printPaired(t, caller);
+        return;
+    }
+    printStats(sum, n, caller);
+    if (controlVariates) {
+        printControlVariates(&t->cv);
+    }
+}
 
-    while (currentIndex > 0) {
-        randomIndex = randomInt(currentIndex);
+void conditionalEstimate(const struct tallies* t, double* estimate, double* variance) {
+    *estimate = t->conditional.mean;
+    *variance = t->conditional.m2 / (t->conditional.n - 1);
+}
 
-        toSwap = array[randomIndex];
-        array[randomIndex] = array[currentIndex];
-        array[currentIndex] = toSwap;
+void printConditional(const struct tallies* t, char* caller) {
+    double mean, var;
+    conditionalEstimate(t, &mean, &var);
+    double n = t->conditional.n;
+    double truth = successTable[numPrisoners];
+    printf("\nStatistics of %s, conditional on the first %d cycles:\n", caller, conditionalCycles);
+    printf("Number of simulations: %lld\n", t->conditional.n);
+    printf("Parameter Estimate = %f\n", mean);
+    // the plain estimator averages Bernoulli(truth) outcomes
+    printf("Variance is %f (%.2f times smaller than the plain estimator)\n",
+           var, var > 0 ? truth*(1 - truth) / var : 1);
+    printf("95%% CI: {%f, %f}\n",
+           mean - 1.96*sqrt(var/n),
+           mean + 1.96*sqrt(var/n));
+    printf("Deviation from true value %.8f = %f (%.2f standard errors)\n",
+           truth, mean - truth, var > 0 ? (mean - truth) / sqrt(var/n) : 0);
+}
 
-        currentIndex--;
-    }
+void printStratified(const struct tallies* t, long long n, char* caller) {
+    double mean, varMean;
+    stratified_estimate(&t->strata, strataWeight, numStrata, &mean, &varMean);
+    double var = varMean * n; // of one simulation, like printStats
+    double truth = exact_probability(numPrisoners, maxTrials);
+    printf("\nStatistics of %s, %d strata of the length of the first cycle:\n", caller, numStrata);
+    printf("Number of simulations: %lld\n", n);
+    printf("Parameter Estimate = %f\n", mean);
+    // the plain estimator averages Bernoulli(truth) outcomes
+    printf("Variance is %f (%.2f times smaller than the plain estimator)\n",
+           var, var > 0 ? truth*(1 - truth) / var : 1);
+    printf("95%% CI: {%f, %f}\n",
+           mean - 1.96*sqrt(varMean),
+           mean + 1.96*sqrt(varMean));
+    printf("Deviation from true value %.8f = %f (%.2f standard errors)\n",
+           truth, mean - truth, varMean > 0 ? (mean - truth) / sqrt(varMean) : 0);
 }
 
-unsigned int randomInt(int currentIndex) {
-#if PRNG == 0 // default c PRNG
-    return random() % (currentIndex+1);
-#elif PRNG == 1 // MRG32k3a PRNG
-    return MRG32k3a() * (currentIndex+1);
-#elif PRNG == 2 // dSFMT (successor of mersenne twister)
-    return dsfmt_genrand_close_open(&dsfmt) * (currentIndex+1);
-#elif PRNG == 3 // Marsa Lfib4 PRNG
-    // to removing inherit bias of modulus, uncomment below,
-    // although there isn't much point since one needs to
-    // be performing simulations to obtain 8 digits of
-    // precision or more... (100/((2^32) - 1) ~= 10^-8)
+long long histogramSize(void) {
+    return 2 * (numPrisoners + 1);
+}
 
-    /*unsigned int randVal = Lfib4();
-    unsigned int modOfMax = MAX_uint32 % (currentIndex+1);
-    while (randVal >= MAX_uint32 - modOfMax) randVal = Lfib4();
+void printHistograms(const long long* histogram, long long n) {
+    if (histogramMode & HISTOGRAM_OUTPUT) {
+        printHistogram(histogram, n);
+    }
+    if (histogramMode & SWEEP_OUTPUT) {
+        printSweep(histogram, n);
+    }
+    if (histogramMode & N_SWEEP_OUTPUT) {
+        printNSweep(histogram, n);
+    }
+}
 
-    return randVal % (currentIndex+1);*/
-    return Lfib4() % (currentIndex+1); // comment this out if above is uncommented
-#endif
+void printNSweep(const long long* successes, long long n) {
+    printf("\nSuccess probability for every number of prisoners "
+           "(prisoners, boxes each: estimate, 95%% CI, exact probability%s):\n",
+           numPrisoners <= MAX_EXACT_HISTOGRAM_PRISONERS ? ", deviation in standard errors" : "");
+    for (long long m=nSweepStep; m<=numPrisoners; m+=nSweepStep) {
+        printNSweepRow(successes, n, m);
+    }
+    if (numPrisoners % nSweepStep != 0) {
+        printNSweepRow(successes, n, numPrisoners); // the last one is numPrisoners, even if it isn't a multiple of the step
+    }
 }
 
-void seed(void) {
-    FILE* urandom = fopen("/dev/urandom", "r");
-    if (urandom == NULL) {
-        perror("Couldn't open urandom file");
-        exit(EXIT_FAILURE);
+void printNSweepRow(const long long* successes, long long n, long long m) {
+    long long limit = m * maxTrials / numPrisoners;
+    double mean = successes[m] / (double)n;
+    double var = (successes[m]*(1 - mean))/(n-1);
+    printf("%lld, %lld: %f, {%f, %f}", m, limit, mean, mean - 1.96*sqrt(var/n), mean + 1.96*sqrt(var/n));
+    if (numPrisoners <= MAX_EXACT_HISTOGRAM_PRISONERS) {
+        double truth = exact_probability(m, limit);
+        printf(", %.8f, %.2f", truth, var > 0 ? (mean - truth) / sqrt(var/n) : 0);
     }
+    printf("\n");
+}
 
-    unsigned int seedVal;
-    if (fread(&seedVal, sizeof(seedVal), 1, urandom) == 0) {
-        perror("Couldn't read urandom file");
-        exit(EXIT_FAILURE);
+void printSweep(const long long* histogram, long long n) {
+    int exact = numPrisoners <= MAX_EXACT_HISTOGRAM_PRISONERS;
+    printf("\nSuccess probability for every trial limit (limit: estimate, 95%% CI%s):\n",
+           exact ? ", exact probability, deviation in standard errors" : "");
+    // the prisoners succeed with every limit at least as long as the longest cycle
+    long long successes = 0;
+    for (long long k=1; k<=numPrisoners; k++) {
+        successes += histogram[k];
+        if (successes == 0) {
+            continue; // no simulation succeeded yet
+        }
+        double mean = successes / (double)n;
+        double var = (successes*(1 - mean))/(n-1);
+        printf("%lld: %f, {%f, %f}", k, mean, mean - 1.96*sqrt(var/n), mean + 1.96*sqrt(var/n));
+        if (exact) {
+            double truth = exact_probability(numPrisoners, k);
+            printf(", %.8f, %.2f", truth, var > 0 ? (mean - truth) / sqrt(var/n) : 0);
+        }
+        printf("\n");
+        if (successes == n) {
+            printf("Every simulation succeeds with a limit of %lld or more\n", k);
+            break;
+        }
     }
-#if PRNG == 0
-    srandom(seedVal);
-#elif PRNG == 1
-    unsigned int seeds[6];
-    seeds[0] = seedVal; // store first rand value at 0
+}
 
-    // store remaining 5 rand values in seeds[1] to seeds[5]
-    if (fread(seeds + 1, sizeof(unsigned int), 5, urandom) == 0) {
-        perror("Couldn't read urandom file for MRG");
-        exit(EXIT_FAILURE);
+void printHistogram(const long long* histogram, long long n) {
+    const long long* cycleCounts = histogram + numPrisoners + 1;
+    int exact = numPrisoners <= MAX_EXACT_HISTOGRAM_PRISONERS;
+    printf("\nLongest cycle (length: simulations, fraction%s):\n", exact ? ", exact probability" : "");
+    double mean = 0;
+    long double below = 0; // exact probability that the longest cycle is shorter
+    for (long long l=1; l<=numPrisoners; l++) {
+        mean += l * (double)histogram[l] / n;
+        long double upTo = exact ? exact_probability(numPrisoners, l) : 0;
+        if (histogram[l] > 0 && exact) {
+            printf("%lld: %lld, %f, %f\n", l, histogram[l], histogram[l] / (double)n, (double)(upTo - below));
+        }
+        else if (histogram[l] > 0) {
+            printf("%lld: %lld, %f\n", l, histogram[l], histogram[l] / (double)n);
+        }
+        below = upTo;
     }
-    mrg_seed_array(seeds);
-#elif PRNG == 2
-    dsfmt_init_gen_rand(&dsfmt, seedVal);
-#elif PRNG == 3
-    unsigned int seeds[1 << 8];
-    if (fread(seeds, sizeof(unsigned int), 1 << 8, urandom) == 0) {
-        perror("Couldn't read urandom file for Lfib4");
-        exit(EXIT_FAILURE);
+    printf("Mean longest cycle length = %f\n", mean);
+
+    printf("\nNumber of cycles (cycles: simulations, fraction):\n");
+    mean = 0;
+    for (long long c=1; c<=numPrisoners; c++) {
+        mean += c * (double)cycleCounts[c] / n;
+        if (cycleCounts[c] > 0) {
+            printf("%lld: %lld, %f\n", c, cycleCounts[c], cycleCounts[c] / (double)n);
+        }
     }
-    Lfib4_seed((unsigned char)seedVal, seeds);
-#endif
+    // a random permutation of n boxes has H(n) cycles on average
+    printf("Mean number of cycles = %f (exact %f)\n", mean, harmonic(numPrisoners));
+}
 
-    fclose(urandom);
+// writes the kind and trial limit of evaluator e to buf, eg. "cycle:50"
+static void formatEvaluator(char* buf, size_t size, const struct evaluator* e) {
+    const char* names[] = { "cycle", "naive", "union" }; // in the order of enum evaluator_t
+    snprintf(buf, size, "%s:%lld", names[e->kind], e->limit);
 }
 
-void simulateAndStatsWithProcesses(int n, int numProcesses) {
-    int pid, sum = 0;
+void printPaired(const struct tallies* t, char* caller) {
+    const paired_sums* s = &t->paired;
+    double n = s->n;
+    char first[32], name[32];
+    formatEvaluator(first, sizeof(first), &evaluators[0]);
+    printf("\nStatistics of %s, %d evaluators of the same permutations:\n", caller, numEvaluators);
+    printf("Number of simulations: %lld\n", s->n);
+    for (int i=0; i<numEvaluators; i++) {
+        double mean = s->y[i] / n;
+        double var = (s->y[i]*(1 - mean))/(n-1);
+        formatEvaluator(name, sizeof(name), &evaluators[i]);
+        printf("%s: Parameter Estimate = %f, 95%% CI: {%f, %f}\n", name, mean,
+               mean - 1.96*sqrt(var/n), mean + 1.96*sqrt(var/n));
+    }
+
+    double truthFirst = exact_probability(numPrisoners, evaluators[0].limit);
+    for (int i=1; i<numEvaluators; i++) {
+        double difference, var, unpaired;
+        paired_difference(s, i, &difference, &var, &unpaired);
+        formatEvaluator(name, sizeof(name), &evaluators[i]);
+        printf("\n%s - %s: Difference = %f\n", name, first, difference);
+        if (s->y[i] + s->y[0] == 2*s->both[i]) {
+            // eg. two implementations of the same strategy and limit
+            printf("They agree on every permutation\n");
+            continue;
+        }
+        printf("Variance is %f (%.2f times smaller than the difference of separate runs)\n",
+               var, var > 0 ? unpaired / var : 1);
+        printf("95%% CI: {%f, %f}\n",
+               difference - 1.96*sqrt(var/n),
+               difference + 1.96*sqrt(var/n));
+        // every evaluator plays the best strategy, with its own limit
+        double truth = exact_probability(numPrisoners, evaluators[i].limit) - truthFirst;
+        printf("Deviation from true value %.8f = %f (%.2f standard errors)\n",
+               truth, difference - truth, var > 0 ? (difference - truth) / sqrt(var/n) : 0);
+    }
+}
+
+// writes exp(logValue) to buf in scientific notation, for probabilities
+// too small for a double
+static void formatLog(char* buf, size_t size, double logValue) {
+    if (logValue == -INFINITY) {
+        snprintf(buf, size, "0");
+        return;
+    }
+    double exponent = floor(logValue / log(10));
+    snprintf(buf, size, "%fe%+.0f", exp(logValue - exponent*log(10)), exponent);
+}
+
+void printImportance(long long n, const struct tallies* t, char* caller) {
+    char estimate[32], low[32], high[32], truth[32];
+    printf("\nStatistics of %s, importance sampling of cycles of at most %lld boxes:\n", caller, maxTrials);
+    printf("Number of simulations: %lld\n", n);
+    // the weights are the likelihood ratios divided by exp(t->logScale)
+    double mean = t->weights / n;
+    double var = (t->weightSquares - n*mean*mean) / (n-1);
+    double relative = sqrt(var/n) / mean; // relative standard error
+    double logMean = t->logScale + log(mean);
+    formatLog(estimate, sizeof(estimate), logMean);
+    formatLog(low, sizeof(low), relative*1.96 < 1 ? logMean + log(1 - relative*1.96) : -INFINITY);
+    formatLog(high, sizeof(high), logMean + log(1 + relative*1.96));
+    printf("Parameter Estimate = %s\n", estimate);
+    printf("Relative standard error = %f\n", relative);
+    printf("95%% CI: {%s, %s}\n", low, high);
+    double ess = t->weights * t->weights / t->weightSquares;
+    printf("Effective sample size = %.0f (%.2f%% of the simulations)\n", ess, 100*ess/n);
+
+    double logTruth = log_exact_probability(numPrisoners, maxTrials);
+    formatLog(truth, sizeof(truth), logTruth);
+    // (estimate - truth) / (relative * estimate)
+    double deviation = 1 - exp(logTruth - logMean);
+    printf("Deviation from true value %s = %+f%% (%.2f standard errors)\n",
+           truth, 100*deviation / (1 - deviation), deviation / relative);
+}
+
+void printControlVariates(const covariate_sums* cv) {
+    double estimate, var;
+    control_variate_estimate(cv, &estimate, &var);
+    double n = cv->n;
+    double mean = cv->y / n;
+    double plainVar = (cv->y*(1 - mean))/(n-1);
+    printf("\nControl variates (cycles, fixed points, first cycle longer than %lld):\n", maxTrials);
+    printf("Parameter Estimate = %f\n", estimate);
+    printf("Variance is %f (%.2f times smaller)\n", var, var > 0 ? plainVar / var : 1);
+    printf("95%% CI: {%f, %f}\n",
+           estimate - 1.96*sqrt(var/n),
+           estimate + 1.96*sqrt(var/n));
+
+    double truth = exact_probability(numPrisoners, maxTrials);
+    printf("Deviation from true value %.8f = %f (%.2f standard errors)\n",
+           truth, estimate - truth, var > 0 ? (estimate - truth) / sqrt(var/n) : 0);
+}
+
+void printExact(long long prisoners, long long trials) {
+    long double p = exact_probability(prisoners, trials);
+    if (p < 0) {
+        fprintf(stderr, "Not enough memory to compute the exact probability\n");
+        exit(EXIT_FAILURE);
+    }
+    printf("Exact probability that all %lld prisoners find their tag opening %lld boxes:\n"
+           "%.15Lg\n", prisoners, trials, p);
+}
+
+// c->index is the next unused word of the buffer. The kernels keep the
+// cursor in a local variable while they run, so the index stays in a register
+// instead of being stored back to the rng after every word.
+static KERNEL_INLINE unsigned int random_word_inline(struct rng_cursor* c) {
+    if (c->index == RANDOM_BUFFER_SIZE) {
+        c->index = rng_refill(c->r);
+    }
+    return c->r->buffer[c->index++];
+}
+
+void initRandomInt(void) {
+    for (unsigned int bound=1; bound<THRESHOLD_TABLE_SIZE; bound++) {
+        rejectionThreshold[bound] = backend->wordRange % bound;
+    }
+}
+
+static KERNEL_INLINE unsigned int random_int_inline(struct rng_cursor* c, int currentIndex) {
+    // Lemire's multiply-shift: the high part of word * bound is uniform on
+    // [0, bound) once the words whose low part falls below range % bound
+    // are rejected. c->range is a power of 2 or a constant, see WITH_WORD_RANGE,
+    // so / and % compile to shifts or multiplies, and the threshold is only
+    // needed when the low part is below bound, which happens about once in
+    // 10^7 draws for 100 boxes.
+    const unsigned long long range = c->range;
+    unsigned long long bound = currentIndex + 1;
+    unsigned long long product = random_word_inline(c) * bound;
+    unsigned long long low = product % range;
+
+    if (low < bound) {
+        unsigned long long threshold = bound < THRESHOLD_TABLE_SIZE ?
+                                       rejectionThreshold[bound] : range % bound;
+        while (low < threshold) {
+            product = random_word_inline(c) * bound;
+            low = product % range;
+        }
+    }
+    return product / range;
+}
+
+// Runs the statements after c with c, a cursor on the buffer of r whose range
+// is the word range of the backend of r as a compile time constant. Each case
+// inlines its own copy of the kernels called from the statements, so they
+// divide by a constant, and the backend is dispatched once per call instead of
+// once per random number.
+#define WITH_WORD_RANGE(r, c, ...) \
+    switch ((r)->backend->wordRange) { \
+    case RNG_RANGE_31: { \
+        struct rng_cursor c = { (r), (r)->index, RNG_RANGE_31 }; \
+        __VA_ARGS__; \
+        (r)->index = c.index; \
+        break; \
+    } \
+    case RNG_RANGE_MRG: { \
+        struct rng_cursor c = { (r), (r)->index, RNG_RANGE_MRG }; \
+        __VA_ARGS__; \
+        (r)->index = c.index; \
+        break; \
+    } \
+    default: { \
+        struct rng_cursor c = { (r), (r)->index, RNG_RANGE_32 }; \
+        __VA_ARGS__; \
+        (r)->index = c.index; \
+        break; \
+    } \
+    }
+
+void initCovariates(void) {
+    harmonicTable[0] = 0;
+    for (int m=1; m<HARMONIC_TABLE_SIZE; m++) {
+        harmonicTable[m] = harmonicTable[m - 1] + 1.0 / m;
+    }
+    covariateMeans[0] = harmonic(numPrisoners);
+    covariateMeans[1] = 1;
+    covariateMeans[2] = (numPrisoners - maxTrials) / (double)numPrisoners;
+}
+
+void initSuccessTable(void) {
+    if (numPrisoners > MAX_CONDITIONAL_PRISONERS) {
+        fprintf(stderr, "The conditional estimator works with at most %d prisoners\n", MAX_CONDITIONAL_PRISONERS);
+        exit(EXIT_FAILURE);
+    }
+    successTable = malloc(sizeof(double) * (numPrisoners + 1));
+    if (successTable == NULL || success_table(numPrisoners, maxTrials, successTable) == -1) {
+        fprintf(stderr, "Not enough memory for the success probabilities of the conditional estimator\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void initStrata(void) {
+    // a cycle of the first box longer than maxTrials fails whatever the rest,
+    // so only the lengths up to maxTrials are sampled
+    numStrata = maxTrials < MAX_STRATA ? maxTrials : MAX_STRATA;
+    for (int h=0; h<=numStrata; h++) {
+        strataLow[h] = 1 + maxTrials * h / numStrata;
+    }
+    for (int h=0; h<numStrata; h++) {
+        // the cycle of the first box has a length uniform on [1, numPrisoners]
+        strataWeight[h] = (strataLow[h + 1] - strataLow[h]) / (double)numPrisoners;
+    }
+}
+
+void initTilted(void) {
+    if (numPrisoners > MAX_TILTED_PRISONERS) {
+        fprintf(stderr, "The tilted engine works with at most %d prisoners\n", MAX_TILTED_PRISONERS);
+        exit(EXIT_FAILURE);
+    }
+    int n = numPrisoners, k = maxTrials;
+    tiltLogX = malloc(sizeof(double) * (n + 1));
+    tiltPowerK = malloc(sizeof(double) * (n + 1));
+    tiltLogNorm = malloc(sizeof(double) * (n + 1));
+    if (tiltLogX == NULL || tiltPowerK == NULL || tiltLogNorm == NULL) {
+        fprintf(stderr, "Not enough memory for the tables of the tilted engine\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Among the permutations of m boxes with no cycle longer than k, the cycle
+    // of a given box has length l with probability close to x^l / m, x being
+    // the saddle point x + x^2 + ... + x^k = m of their generating function.
+    // Solve for y = log x with Newton's method, starting from the y of m - 1
+    // since y grows slowly with m, and the sum written with expm1 to keep its
+    // precision for x close to 1.
+    double y = 2.0 / ((double)k * (k + 1)); // about the y of m = k + 1
+    for (int m=k+1; m<=n; m++) {
+        for (int i=0; i<50; i++) {
+            // log(x + ... + x^k) - log m and its derivative in y
+            double f = y + log(expm1(k*y)) - log(expm1(y)) - log(m);
+            double df = 1 + k*exp(k*y)/expm1(k*y) - exp(y)/expm1(y);
+            double step = f / df;
+            y = y - step > 0 ? y - step : y / 2;
+            if (fabs(step) < 1e-14 * y) {
+                break;
+            }
+        }
+        tiltLogX[m] = y;
+        tiltPowerK[m] = expm1(k*y);
+        tiltLogNorm[m] = y + log(expm1(k*y)) - log(expm1(y)) - log(m);
+    }
+}
+
+double harmonic(int m) {
+    if (m < HARMONIC_TABLE_SIZE) {
+        return harmonicTable[m];
+    }
+    double inv2 = 1.0 / ((double)m * m);
+    return log(m) + 0.57721566490153286 + 0.5 / m - inv2*(1.0/12 - inv2/120);
+}
+
+// Sets the centered covariates x of a simulation that stopped with "left" boxes
+// in cycles it hasn't walked, after walking "cycles" cycles, "fixedPoints" of
+// them of length 1. Whatever the walked cycles, the boxes left form a uniformly
+// random permutation, with H(left) cycles and 1 fixed point on average, so x
+// holds the expected covariates given what the kernel saw. They keep the exact
+// means of covariateMeans, and vary less than the covariates of the whole permutation.
+static KERNEL_INLINE void setCovariates(double* x, int cycles, int fixedPoints, int longFirst, int left) {
+    if (x != NULL) { // NULL when the covariates are unused, the tracking then compiles away
+        x[0] = cycles + harmonic(left) - covariateMeans[0];
+        x[1] = fixedPoints + (left > 0) - covariateMeans[1];
+        x[2] = longFirst - covariateMeans[2];
+    }
+}
+
+// the kernels below are shared by the generic simulations and the ones
+// specialized for fixed sizes and limits, see SPECIALIZED_KERNELS.
+// Each one is inlined into a dozen callers, so past gcc's inlining limits
+// without always_inline.
+static KERNEL_INLINE enum found_t union_find_kernel(struct rng_cursor* c, set_union* s, int size, int limit) {
+    int currentIndex = size - 1;
+    int randomIndex;
+
+    set_union_init_inline(s, size);
+    while (currentIndex > 0) {
+        randomIndex = random_int_inline(c, currentIndex);
+
+        if (union_set_inline(s, currentIndex, randomIndex) > limit) {
+            return NOT_FOUND;
+        }
+
+        currentIndex--;
+    }
+    return FOUND;
+}
+
+// "inside-out" Fisher-Yates shuffle, initializes and shuffles boxes in one pass
+static KERNEL_INLINE void permutation_kernel(struct rng_cursor* c, int* boxes, int size) {
+    for (int i=0; i<size; i++) {
+        int randomIndex = random_int_inline(c, i);
+        boxes[i] = boxes[randomIndex];
+        boxes[randomIndex] = i;
+    }
+}
+
+// walks the cycles of the permutation boxes, see cycle_walk_kernel
+static KERNEL_INLINE enum found_t cycle_check_kernel(const int* boxes, unsigned long long* visited,
+                                                     int size, int limit, double* x) {
+    memset(visited, 0, sizeof(unsigned long long) * ((size + 63) / 64));
+
+    int unvisited = size;
+    int cycles = 0, fixedPoints = 0; // walked so far, for the covariates
+    for (int start=0; start<size; start++) {
+        // once the boxes left to visit can't hold a cycle longer than limit,
+        // every remaining prisoner is guaranteed to find his tag
+        if (unvisited <= limit) {
+            setCovariates(x, cycles, fixedPoints, 0, unvisited);
+            return FOUND;
+        }
+        if (visited[start / 64] & (1ULL << (start % 64))) {
+            continue;
+        }
+
+        int length = 0;
+        int current = start;
+        do {
+            visited[current / 64] |= 1ULL << (current % 64);
+            current = boxes[current];
+            length++;
+        } while (current != start);
+
+        unvisited -= length;
+        cycles++;
+        fixedPoints += length == 1;
+        if (length > limit) {
+            setCovariates(x, cycles, fixedPoints, start == 0, unvisited);
+            return NOT_FOUND;
+        }
+    }
+    setCovariates(x, cycles, fixedPoints, 0, 0);
+    return FOUND;
+}
+
+static KERNEL_INLINE enum found_t cycle_walk_kernel(struct rng_cursor* c, int* boxes, unsigned long long* visited,
+                                             int size, int limit, double* x) {
+    permutation_kernel(c, boxes, size);
+    return cycle_check_kernel(boxes, visited, size, limit, x);
+}
+
+// Profile version of cycle_walk_kernel for --histogram: walks every cycle,
+// and returns the number of cycles, the longest one in *longest.
+// Without allCycles, for --sweep, it stops once the boxes left to visit can't
+// hold a cycle longer than the longest so far instead, and only returns the
+// number of cycles walked.
+static KERNEL_INLINE int cycle_profile_kernel(struct rng_cursor* c, int* boxes, unsigned long long* visited,
+                                              int size, int* longest, int allCycles) {
+    permutation_kernel(c, boxes, size);
+    memset(visited, 0, sizeof(unsigned long long) * ((size + 63) / 64));
+
+    int cycles = 0;
+    int unvisited = size;
+    *longest = 0;
+    for (int start=0; start<size; start++) {
+        if (!allCycles && unvisited <= *longest) {
+            break;
+        }
+        if (visited[start / 64] & (1ULL << (start % 64))) {
+            continue;
+        }
+        int length = 0;
+        int current = start;
+        do {
+            visited[current / 64] |= 1ULL << (current % 64);
+            current = boxes[current];
+            length++;
+        } while (current != start);
+
+        unvisited -= length;
+        cycles++;
+        if (length > *longest) {
+            *longest = length;
+        }
+    }
+    return cycles;
+}
+
+static KERNEL_INLINE int look_for_tag_kernel(int prisonerNum, int boxes[], int limit) {
+    int currentNum = prisonerNum;
+
+    // have the prisoner check each box
+    for (int trials=0; trials<limit; trials++) {
+        if (prisonerNum == boxes[currentNum]) { // prisoner checks number inside box
+            return FOUND;
+        }
+        else {
+            currentNum = boxes[currentNum]; // use number in box to search for next box
+        }
+    }
+    return NOT_FOUND; // exhausted all "limit" boxes
+}
+
+static KERNEL_INLINE void shuffle_kernel(struct rng_cursor* c, int* array, int size) {
+    int currentIndex = size - 1;
+    int randomIndex;
+    int toSwap;
+
+    while (currentIndex > 0) {
+        randomIndex = random_int_inline(c, currentIndex);
+
+        toSwap = array[randomIndex];
+        array[randomIndex] = array[currentIndex];
+        array[currentIndex] = toSwap;
+
+        currentIndex--;
+    }
+}
+
+// Custom strategy of --strategy custom: the box a prisoner opens first, and
+// the one he opens after finding "tag" in "box" on trial "trial". Edit these
+// two to try out a strategy of your own at the speed of the others. This one
+// starts from the box after his own and opens the box after each number he
+// finds, which follows the cycles of another random permutation, so it
+// succeeds as often as the cycle strategy.
+static KERNEL_INLINE int custom_first_box(int prisoner, int size) {
+    return prisoner + 1 == size ? 0 : prisoner + 1;
+}
+
+static KERNEL_INLINE int custom_next_box(int prisoner, int trial, int box, int tag, int size) {
+    (void)prisoner, (void)trial, (void)box; // unused by this strategy, but there for your own
+    return tag + 1 == size ? 0 : tag + 1;
+}
+
+static KERNEL_INLINE enum found_t custom_search_kernel(int prisoner, int* boxes, int size, int limit) {
+    int box = custom_first_box(prisoner, size);
+    for (int trials=0; trials<limit; trials++) {
+        int tag = boxes[box];
+        if (tag == prisoner) {
+            return FOUND;
+        }
+        box = custom_next_box(prisoner, trials, box, tag, size);
+    }
+    return NOT_FOUND;
+}
+
+// Random strategy: the prisoner opens limit distinct boxes drawn at random,
+// the first ones of a partial shuffle of order. The swaps, saved after the
+// size boxes of order, are undone after, so order is the same for every
+// prisoner and the boxes opened only depend on the random numbers.
+static KERNEL_INLINE enum found_t random_search_kernel(struct rng_cursor* c, int prisoner, int* boxes, int* order,
+                                                       int size, int limit) {
+    int* swapped = order + size;
+    enum found_t found = NOT_FOUND;
+    int trials = 0;
+    while (trials < limit && found == NOT_FOUND) {
+        int j = trials + random_int_inline(c, size - 1 - trials); // uniform on [trials, size-1]
+        int box = order[j];
+        order[j] = order[trials];
+        order[trials] = box;
+        swapped[trials++] = j;
+        found = boxes[box] == prisoner;
+    }
+    while (trials-- > 0) {
+        int j = swapped[trials];
+        int box = order[j];
+        order[j] = order[trials];
+        order[trials] = box;
+    }
+    return found;
+}
+
+// Window strategy: the prisoner opens the limit boxes from his own one on,
+// wrapping around after the last box.
+static KERNEL_INLINE enum found_t window_search_kernel(int prisoner, int* boxes, int size, int limit) {
+    int box = prisoner;
+    for (int trials=0; trials<limit; trials++) {
+        if (boxes[box] == prisoner) {
+            return FOUND;
+        }
+        box = box + 1 == size ? 0 : box + 1;
+    }
+    return NOT_FOUND;
+}
+
+// Batched evaluator of the strategies: every prisoner in turn looks for his
+// tag in the shared boxes with "strategy", and the evaluation stops at the
+// first one who doesn't find it. strategy is a constant wherever this is
+// inlined, see WITH_STRATEGY, so only the search of its own strategy is
+// compiled in, without testing the strategy for every prisoner.
+static KERNEL_INLINE enum found_t strategy_check_kernel(struct rng_cursor* c, enum strategy_t strategy, int* boxes,
+                                                        int* order, int size, int limit) {
+    for (int i=0; i<size; i++) {
+        enum found_t found;
+        if (strategy == CYCLE_STRATEGY) {
+            found = look_for_tag_kernel(i, boxes, limit);
+        }
+        else if (strategy == RANDOM_STRATEGY) {
+            found = random_search_kernel(c, i, boxes, order, size, limit);
+        }
+        else if (strategy == WINDOW_STRATEGY) {
+            found = window_search_kernel(i, boxes, size, limit);
+        }
+        else {
+            found = custom_search_kernel(i, boxes, size, limit);
+        }
+        if (found == NOT_FOUND) {
+            return NOT_FOUND;
+        }
+    }
+    return FOUND;
+}
+
+// Shuffles the boxes like the cycle walk engine, so the cycle strategy judges
+// the same permutations as -e cycle, then evaluates them with "strategy".
+static KERNEL_INLINE enum found_t strategy_kernel(struct rng_cursor* c, enum strategy_t strategy, int* boxes,
+                                                  int* order, int size, int limit) {
+    permutation_kernel(c, boxes, size);
+    return strategy_check_kernel(c, strategy, boxes, order, size, limit);
+}
+
+// Sets found to the outcome of strategy_kernel with the strategy of --strategy
+// as a constant, like WITH_WORD_RANGE does with the word range.
+#define WITH_STRATEGY(found, ...) \
+    switch (strategy) { \
+    case CYCLE_STRATEGY: \
+        found = strategy_kernel(&c, CYCLE_STRATEGY, __VA_ARGS__); \
+        break; \
+    case RANDOM_STRATEGY: \
+        found = strategy_kernel(&c, RANDOM_STRATEGY, __VA_ARGS__); \
+        break; \
+    case WINDOW_STRATEGY: \
+        found = strategy_kernel(&c, WINDOW_STRATEGY, __VA_ARGS__); \
+        break; \
+    default: \
+        found = strategy_kernel(&c, CUSTOM_STRATEGY, __VA_ARGS__); \
+        break; \
+    }
+
+static KERNEL_INLINE int batch_kernel(struct rng_cursor* c, set_union_batch* s, int size, int limit) {
+    const unsigned int allLanes = (1u << BATCH_LANES) - 1;
+    unsigned int failed = 0; // bit l is set once lane l holds a set larger than limit
+    int randomIndex[BATCH_LANES];
+
+    set_union_batch_init(s, size);
+    for (int currentIndex = size - 1; currentIndex > 0 && failed != allLanes; currentIndex--) {
+        for (int l=0; l<BATCH_LANES; l++) {
+            randomIndex[l] = random_int_inline(c, currentIndex);
+        }
+        failed |= union_set_batch(s, currentIndex, randomIndex, limit);
+    }
+    return BATCH_LANES - __builtin_popcount(failed);
+}
+
+static KERNEL_INLINE enum found_t feller_kernel(struct rng_cursor* c, int size, int limit, double* x) {
+    int last = size + 1; // position of the previous success, size+1 always succeeds
+    int cycles = 0, fixedPoints = 0; // gaps drawn so far, for the covariates
+
+    // stop once the positions left can't hold a gap longer than limit
+    while (last - 1 > limit) {
+        int next = random_int_inline(c, last - 2) + 1; // next success, uniform on [1, last-1]
+        cycles++;
+        fixedPoints += last - next == 1;
+        if (last - next > limit) {
+            // the first gap is the cycle of the box at the top
+            setCovariates(x, cycles, fixedPoints, last == size + 1, next - 1);
+            return NOT_FOUND;
+        }
+        last = next;
+    }
+    setCovariates(x, cycles, fixedPoints, 0, last - 1);
+    return FOUND;
+}
+
+// Profile version of feller_kernel for --histogram: draws every gap down to
+// the bottom, and returns the number of cycles, the longest one in *longest.
+// Without allCycles, for --sweep, it stops once the positions left can't hold
+// a gap longer than the longest so far instead, like cycle_profile_kernel.
+static KERNEL_INLINE int feller_profile_kernel(struct rng_cursor* c, int size, int* longest, int allCycles) {
+    int last = size + 1;
+    int cycles = 0;
+    *longest = 0;
+    while (last > 1 && (allCycles || last - 1 > *longest)) {
+        int next = random_int_inline(c, last - 2) + 1;
+        if (last - next > *longest) {
+            *longest = last - next;
+        }
+        cycles++;
+        last = next;
+    }
+    return cycles;
+}
+
+// Chinese restaurant version of the cycle walk for --n-sweep: grows the
+// permutation one prisoner at a time, the new one either starting a cycle of
+// his own or following a uniformly chosen earlier prisoner in his cycle, so
+// the cycles of the first m prisoners are the ones of a random permutation of
+// m boxes for every m. Adds the success of every m of the grid, with
+// m limit / size boxes each, to successes[m], and stops once the longest
+// cycle is longer than limit, as every larger m fails from then on.
+static KERNEL_INLINE enum found_t restaurant_kernel(struct rng_cursor* c, int* cycleOf, int* cycleLength,
+                                                    int size, int limit, int step, long long* successes) {
+    int cycles = 0, longest = 0;
+    int next = step < size ? step : size; // next number of prisoners of the grid
+    for (int m=1; m<=size; m++) {
+        int j = random_int_inline(c, m - 1); // earlier prisoner on [0, m-2], or m-1 for a cycle of its own
+        int cycle = j == m - 1 ? cycles++ : cycleOf[j];
+        if (j == m - 1) {
+            cycleLength[cycle] = 0;
+        }
+        cycleOf[m - 1] = cycle;
+        if (++cycleLength[cycle] > longest) {
+            longest = cycleLength[cycle];
+            if (longest > limit) {
+                return NOT_FOUND;
+            }
+        }
+        if (m == next) {
+            successes[m] += longest <= (long long)m * limit / size;
+            next = size - m > step ? m + step : size;
+        }
+    }
+    return FOUND;
+}
+
+// Importance sampling version of feller_kernel: with m boxes left, the
+// cycle of the top one has a length l uniform on [1, m] for a uniformly random
+// permutation, but is drawn from x^l / (x + x^2 + ... + x^limit) on [1, limit]
+// here, tilted to the lengths of the permutations that succeed, see initTilted.
+// Every simulation succeeds, and returns the log of its likelihood ratio, the
+// product of (1 / m) / (x^l / (x + ... + x^limit)) over its cycles. Once the
+// boxes left can't hold a long cycle, both distributions agree on the rest,
+// so it isn't drawn. l is drawn by inversion from a uniform number of two
+// words, whose granularity of about 2^-62 is far below the precision of any
+// estimate, so the ratios are computed for the exact tilted distribution.
+static KERNEL_INLINE double tilted_kernel(struct rng_cursor* c, int size, int limit) {
+    int m = size;
+    double logRatio = 0;
+    while (m > limit) {
+        const double range = c->range;
+        unsigned int high = random_word_inline(c);
+        unsigned int low = random_word_inline(c);
+        double u = (high + (low + 0.5) / range) / range; // uniform on (0, 1)
+        int l = ceil(log1p(u * tiltPowerK[m]) / tiltLogX[m]);
+        l = l < 1 ? 1 : l > limit ? limit : l;
+        logRatio += tiltLogNorm[m] - l * tiltLogX[m];
+        m -= l;
+    }
+    return logRatio;
+}
+
+// Rao-Blackwell version of feller_kernel: samples the first "prefix" cycles
+// only, then returns the probability that the boxes left have no cycle longer
+// than limit. Whatever the cycles sampled, the boxes left form a uniformly
+// random permutation, so its expected value is the same success probability,
+// and it is never more variable than the outcome of the whole simulation.
+static KERNEL_INLINE double feller_conditional_kernel(struct rng_cursor* c, int size, int limit, int prefix) {
+    int last = size + 1;
+    for (int cycles=0; cycles<prefix && last - 1 > limit; cycles++) {
+        int next = random_int_inline(c, last - 2) + 1;
+        if (last - next > limit) {
+            return 0;
+        }
+        last = next;
+    }
+    return successTable[last - 1];
+}
+
+// Stratified version of feller_kernel: the gap at the top, the cycle of the
+// first box, is set to "length" instead of uniform on [1, size]. Whatever its
+// length, the boxes left form a uniformly random permutation, drawn like the
+// rest of feller_kernel. length is at most limit, the longer ones always fail.
+static KERNEL_INLINE enum found_t stratified_kernel(struct rng_cursor* c, int size, int limit, int length) {
+    return feller_kernel(c, size - length, limit, NULL);
+}
+
+// the evaluators of --paired, which judge a permutation of the boxes
+// without drawing any random number, see runPairedSimulation
+static KERNEL_INLINE enum found_t naive_check_kernel(int* boxes, int size, int limit) {
+    return strategy_check_kernel(NULL, CYCLE_STRATEGY, boxes, NULL, size, limit);
+}
+
+static KERNEL_INLINE enum found_t union_check_kernel(set_union* s, const int* boxes, int size, int limit) {
+    set_union_init_inline(s, size);
+    for (int i=0; i<size; i++) {
+        if (union_set_inline(s, i, boxes[i]) > limit) {
+            return NOT_FOUND;
+        }
+    }
+    return FOUND;
+}
+
+void runPairedSimulation(struct rng* r, struct workspace* w, int* y) {
+    WITH_WORD_RANGE(r, c, permutation_kernel(&c, w->boxes, numPrisoners));
+    for (int i=0; i<numEvaluators; i++) {
+        int limit = evaluators[i].limit;
+        if (evaluators[i].kind == CYCLE_EVALUATOR) {
+            y[i] = cycle_check_kernel(w->boxes, w->visited, numPrisoners, limit, NULL);
+        }
+        else if (evaluators[i].kind == NAIVE_EVALUATOR) {
+            y[i] = naive_check_kernel(w->boxes, numPrisoners, limit);
+        }
+        else {
+            y[i] = union_check_kernel(&w->s, w->boxes, numPrisoners, limit);
+        }
+    }
+}
+
+enum found_t single_simulation(struct rng* r, set_union* s, int size, int limit) {
+    enum found_t found;
+    WITH_WORD_RANGE(r, c, found = union_find_kernel(&c, s, size, limit));
+    return found;
+}
+
+enum found_t cycle_simulation(struct rng* r, int* boxes, unsigned long long* visited, int size, int limit) {
+    enum found_t found;
+    WITH_WORD_RANGE(r, c, found = cycle_walk_kernel(&c, boxes, visited, size, limit, NULL));
+    return found;
+}
+
+int batch_simulation(struct rng* r, set_union_batch* s, int size, int limit) {
+    int successes;
+    WITH_WORD_RANGE(r, c, successes = batch_kernel(&c, s, size, limit));
+    return successes;
+}
+
+enum found_t feller_simulation(struct rng* r, int size, int limit) {
+    enum found_t found;
+    WITH_WORD_RANGE(r, c, found = feller_kernel(&c, size, limit, NULL));
+    return found;
+}
+
+enum found_t stratified_simulation(struct rng* r, int size, int limit, int length) {
+    enum found_t found;
+    WITH_WORD_RANGE(r, c, found = stratified_kernel(&c, size, limit, length));
+    return found;
+}
+
+int lookForTag(int prisonerNum, int boxes[], int limit) {
+    return look_for_tag_kernel(prisonerNum, boxes, limit);
+}
+
+// The kernels selected at startup are compiled once per word range, so each
+// divides by its range as a constant without the switch of WITH_WORD_RANGE.
+#define WORD_RANGES(X, ...)                    \
+    X(__VA_ARGS__, 31, RNG_RANGE_31)           \
+    X(__VA_ARGS__, mrg, RNG_RANGE_MRG)         \
+    X(__VA_ARGS__, 32, RNG_RANGE_32)
+
+// Generic kernels work for any number of prisoners and trial limit,
+// with the buffers passed in.
+#define DEFINE_GENERIC_KERNELS(NAME, R, RANGE) \
+static enum found_t NAME##_union_find_##R(struct rng* r, set_union* s) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = union_find_kernel(&c, s, numPrisoners, maxTrials); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t NAME##_cycle_walk_##R(struct rng* r, int* boxes, unsigned long long* visited) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = cycle_walk_kernel(&c, boxes, visited, numPrisoners, maxTrials, NULL); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t NAME##_cycle_walk_covariates_##R(struct rng* r, int* boxes, unsigned long long* visited, \
+                                                     double* x) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = cycle_walk_kernel(&c, boxes, visited, numPrisoners, maxTrials, x); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t NAME##_strategy_##R(struct rng* r, int* boxes, int* order) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found; \
+    WITH_STRATEGY(found, boxes, order, numPrisoners, maxTrials); \
+    r->index = c.index; \
+    return found; \
+} \
+static int NAME##_batch_##R(struct rng* r, set_union_batch* s) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int successes = batch_kernel(&c, s, numPrisoners, maxTrials); \
+    r->index = c.index; \
+    return successes; \
+} \
+static enum found_t NAME##_feller_##R(struct rng* r) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = feller_kernel(&c, numPrisoners, maxTrials, NULL); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t NAME##_feller_covariates_##R(struct rng* r, double* x) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = feller_kernel(&c, numPrisoners, maxTrials, x); \
+    r->index = c.index; \
+    return found; \
+} \
+static double NAME##_feller_conditional_##R(struct rng* r) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    double p = feller_conditional_kernel(&c, numPrisoners, maxTrials, conditionalCycles); \
+    r->index = c.index; \
+    return p; \
+} \
+static double NAME##_tilted_##R(struct rng* r) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    double logRatio = tilted_kernel(&c, numPrisoners, maxTrials); \
+    r->index = c.index; \
+    return logRatio; \
+} \
+static int NAME##_cycle_walk_profile_##R(struct rng* r, int* boxes, unsigned long long* visited, int* longest) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int cycles = cycle_profile_kernel(&c, boxes, visited, numPrisoners, longest, 1); \
+    r->index = c.index; \
+    return cycles; \
+} \
+static int NAME##_feller_profile_##R(struct rng* r, int* longest) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int cycles = feller_profile_kernel(&c, numPrisoners, longest, 1); \
+    r->index = c.index; \
+    return cycles; \
+} \
+static int NAME##_cycle_walk_longest_##R(struct rng* r, int* boxes, unsigned long long* visited, int* longest) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int cycles = cycle_profile_kernel(&c, boxes, visited, numPrisoners, longest, 0); \
+    r->index = c.index; \
+    return cycles; \
+} \
+static int NAME##_feller_longest_##R(struct rng* r, int* longest) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int cycles = feller_profile_kernel(&c, numPrisoners, longest, 0); \
+    r->index = c.index; \
+    return cycles; \
+} \
+static enum found_t NAME##_restaurant_##R(struct rng* r, int* cycleOf, int* cycleLength, long long* successes) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = restaurant_kernel(&c, cycleOf, cycleLength, numPrisoners, maxTrials, nSweepStep, \
+                                           successes); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t NAME##_stratified_##R(struct rng* r, int low, int count) { \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    int length = low + random_int_inline(&c, count - 1); /* uniform in the stratum */ \
+    enum found_t found = stratified_kernel(&c, numPrisoners, maxTrials, length); \
+    r->index = c.index; \
+    return found; \
+}
+WORD_RANGES(DEFINE_GENERIC_KERNELS, generic)
+#undef DEFINE_GENERIC_KERNELS
+
+// Specialized kernels work on fixed size buffers on the stack, with the
+// size and the limit known at compile time, so the compiler can unroll the
+// initialization and fold every bound. The buffers passed in are unused,
+// but for the order of the strategies, which has to last across simulations.
+#define DEFINE_KERNELS(N, K, R, RANGE) \
+static enum found_t union_find_##N##_##K##_##R(struct rng* r, set_union* s) { \
+    (void)s; \
+    int p[N], size[N]; \
+    set_union local = { p, size, N }; \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = union_find_kernel(&c, &local, N, K); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t cycle_walk_##N##_##K##_##R(struct rng* r, int* boxes, unsigned long long* visited) { \
+    (void)boxes, (void)visited; \
+    int localBoxes[N]; \
+    unsigned long long localVisited[(N + 63) / 64]; \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = cycle_walk_kernel(&c, localBoxes, localVisited, N, K, NULL); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t cycle_walk_covariates_##N##_##K##_##R(struct rng* r, int* boxes, unsigned long long* visited, \
+                                                          double* x) { \
+    (void)boxes, (void)visited; \
+    int localBoxes[N]; \
+    unsigned long long localVisited[(N + 63) / 64]; \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found = cycle_walk_kernel(&c, localBoxes, localVisited, N, K, x); \
+    r->index = c.index; \
+    return found; \
+} \
+static enum found_t strategy_##N##_##K##_##R(struct rng* r, int* boxes, int* order) { \
+    (void)boxes; \
+    int localBoxes[N]; \
+    struct rng_cursor c = { r, r->index, RANGE }; \
+    enum found_t found; \
+    WITH_STRATEGY(found, localBoxes, order, N, K); \
+    r->index = c.index; \
+    return found; \
+}
+#define DEFINE_RANGE_KERNELS(N, K) WORD_RANGES(DEFINE_KERNELS, N, K)
+SPECIALIZED_KERNELS(DEFINE_RANGE_KERNELS)
+#undef DEFINE_RANGE_KERNELS
+#undef DEFINE_KERNELS
+
+void selectKernels(struct kernels* k, int size, int limit, unsigned long long range) {
+#define SELECT_GENERIC_KERNELS(NAME, R, RANGE) \
+    if (range == RANGE) { \
+        *k = (struct kernels){ NAME##_union_find_##R, NAME##_cycle_walk_##R, NAME##_strategy_##R, \
+                               NAME##_batch_##R, NAME##_feller_##R, \
+                               NAME##_cycle_walk_covariates_##R, NAME##_feller_covariates_##R, \
+                               NAME##_feller_conditional_##R, NAME##_tilted_##R, \
+                               NAME##_stratified_##R, NAME##_cycle_walk_profile_##R, \
+                               NAME##_feller_profile_##R, NAME##_cycle_walk_longest_##R, \
+                               NAME##_feller_longest_##R, NAME##_restaurant_##R }; \
+    }
+    WORD_RANGES(SELECT_GENERIC_KERNELS, generic)
+#undef SELECT_GENERIC_KERNELS
+
+#define SELECT_KERNELS(N, K, R, RANGE) \
+    if (size == N && limit == K && range == RANGE) { \
+        k->union_find = union_find_##N##_##K##_##R; \
+        k->cycle_walk = cycle_walk_##N##_##K##_##R; \
+        k->cycle_walk_covariates = cycle_walk_covariates_##N##_##K##_##R; \
+        k->strategy = strategy_##N##_##K##_##R; \
+    }
+#define SELECT_RANGE_KERNELS(N, K) WORD_RANGES(SELECT_KERNELS, N, K)
+    SPECIALIZED_KERNELS(SELECT_RANGE_KERNELS)
+#undef SELECT_RANGE_KERNELS
+#undef SELECT_KERNELS
+}
+
+void printThroughput(long long n, double seconds) {
+    printf("Elapsed time: %f seconds (%f simulations per second)\n", seconds, n / seconds);
+}
+
+void randomizeArray(struct rng* r, int* array, int size) {
+    WITH_WORD_RANGE(r, c, shuffle_kernel(&c, array, size));
+}
+
+unsigned int randomInt(struct rng* r, int currentIndex) {
+    unsigned int value;
+    WITH_WORD_RANGE(r, c, value = random_int_inline(&c, currentIndex));
+    return value;
+}
+
+void readUrandom(void* buf, size_t size) {
+    FILE* urandom = fopen("/dev/urandom", "r");
+    if (urandom == NULL) {
+        perror("Couldn't open urandom file");
+        exit(EXIT_FAILURE);
+    }
+    if (fread(buf, size, 1, urandom) == 0) {
+        perror("Couldn't read urandom file");
+        exit(EXIT_FAILURE);
+    }
+    fclose(urandom);
+}
+
+void seed(struct rng* r, int stream) {
+    rng_init(r, backend, runSeed, stream);
+}
+
+void seedSimulation(struct rng* r, long long i) {
+    if (r->backend->seedSimulation != NULL) {
+        r->backend->seedSimulation(r, i);
+        r->index = RANDOM_BUFFER_SIZE; // drop the words of the previous simulation
+    }
+}
+
+void simulateAndStatsWithProcesses(long long n, int numProcesses) {
+    int pid;
+    long long sum = 0;
     // create array that all processes can communicate with
-    int* successes = mmap(NULL, sizeof(int)*numProcesses,
+    long long* successes = mmap(NULL, sizeof(long long)*numProcesses,
                           PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+    struct tallies* tallies = mmap(NULL, sizeof(struct tallies)*numProcesses,
+                                   PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+    // one histogram per process, merged by the parent once they are done
+    size_t histogramBytes = histogramMode ? sizeof(long long)*histogramSize()*numProcesses : 0;
+    long long* histograms = NULL;
+    if (histogramMode) {
+        histograms = mmap(NULL, histogramBytes, PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+        if (histograms == MAP_FAILED) {
+            perror("Couldn't share the histograms with the processes");
+            exit(EXIT_FAILURE);
+        }
+    }
     struct simParam listOfParam[numProcesses];
 
     // let parent fork() multiple times and wait for children to simulate.
@@ -283,8 +2026,12 @@ void simulateAndStatsWithProcesses(int n, int numProcesses) {
         if (pid == 0) { // children
             listOfParam[i].taskName =       "Process";
             listOfParam[i].successes =      successes;
+            listOfParam[i].tallies =        tallies;
+            listOfParam[i].histograms =     histograms;
             listOfParam[i].taskNum =        i;
-            listOfParam[i].numSimulations = n / numProcesses;
+            // the first n % numProcesses processes perform one more simulation
+            listOfParam[i].firstSimulation = n / numProcesses * i + (i < n % numProcesses ? i : n % numProcesses);
+            listOfParam[i].numSimulations = n / numProcesses + (i < n % numProcesses);
             splitSimulation(&listOfParam[i]);
             exit(EXIT_SUCCESS); // children finished simulating
         }
@@ -295,32 +2042,392 @@ void simulateAndStatsWithProcesses(int n, int numProcesses) {
     }
     while (wait(NULL) > 0); // let parent wait for all children processes to exit
 
+    struct tallies all;
+    tallies_init(&all);
     for (int i=0; i<numProcesses; i++) {
         sum += successes[i];
+        tallies_merge(&all, &tallies[i]);
+    }
+    printResults(sum, n, &all, "All processes");
+    if (histogramMode) {
+        for (int i=1; i<numProcesses; i++) { // into the histogram of the first process
+            for (long long j=0; j<histogramSize(); j++) {
+                histograms[j] += histograms[i*histogramSize() + j];
+            }
+        }
+        printHistograms(histograms, n);
+        munmap(histograms, histogramBytes);
+    }
+}
+
+// packs the chunks [begin, end) of a work stealing range in one atomic word
+static inline unsigned long long packRange(unsigned int begin, unsigned int end) {
+    return (unsigned long long)begin << 32 | end;
+}
+
+static inline unsigned int rangeBegin(unsigned long long range) {
+    return range >> 32;
+}
+
+static inline unsigned int rangeEnd(unsigned long long range) {
+    return (unsigned int)range;
+}
+
+// takes the first chunk of the range of worker "self", the owner of the range
+static int popChunk(struct stealingWorker* self, unsigned int* chunk) {
+    unsigned long long range = atomic_load_explicit(&self->range, memory_order_relaxed);
+    while (rangeBegin(range) < rangeEnd(range)) {
+        unsigned long long taken = packRange(rangeBegin(range) + 1, rangeEnd(range));
+        if (atomic_compare_exchange_weak_explicit(&self->range, &range, taken,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            *chunk = rangeBegin(range);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// moves the last half of the range of another worker to the empty range of "self"
+static int stealChunks(struct stealingPool* pool, struct stealingWorker* self) {
+    for (int i=1; i<pool->numWorkers; i++) {
+        struct stealingWorker* victim = &pool->workers[(self->id + i) % pool->numWorkers];
+        unsigned long long range = atomic_load_explicit(&victim->range, memory_order_relaxed);
+        while (rangeBegin(range) < rangeEnd(range)) {
+            unsigned int begin = rangeBegin(range), end = rangeEnd(range);
+            unsigned int middle = end - (end - begin + 1) / 2;
+            if (atomic_compare_exchange_weak_explicit(&victim->range, &range, packRange(begin, middle),
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                atomic_store_explicit(&self->range, packRange(middle, end), memory_order_relaxed);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void* stealingSimulation(void* arg) {
+    struct stealingWorker* self = arg;
+    struct stealingPool* pool = self->pool;
+    if (!self->started) { // the workspace lasts for every run of the pool
+        workspace_init(&self->w, engine, numPrisoners);
+        seed(&self->w.rng, self->id); // every thread has its own PRNG state
+        self->started = 1;
+    }
+
+    long long sum = 0, performed = 0;
+    unsigned int chunk;
+    while (popChunk(self, &chunk) || (stealChunks(pool, self) && popChunk(self, &chunk))) {
+        long long first = chunk * pool->chunkSize;
+        long long n = pool->numSimulations - first < pool->chunkSize ? pool->numSimulations - first : pool->chunkSize;
+        sum += simulateRange(&self->w, pool->firstSimulation + first, n);
+        performed += n;
+    }
+
+    self->successes = sum;
+    self->performed = performed;
+    return NULL;
+}
+
+void stealingPool_init(struct stealingPool* pool, int numThreads) {
+    pool->numWorkers = numThreads;
+    pool->workers = aligned_alloc(64, sizeof(struct stealingWorker) * numThreads);
+    if (pool->workers == NULL) {
+        perror("Couldn't allocate the threads");
+        exit(EXIT_FAILURE);
     }
-    int numSimulation = (n / numProcesses)*numProcesses; // integer division
-    printStats(sum, numSimulation, "All processes");
+    for (int i=0; i<numThreads; i++) {
+        pool->workers[i].id = i;
+        pool->workers[i].pool = pool;
+        pool->workers[i].started = 0;
+    }
+}
+
+long long stealingPool_run(struct stealingPool* pool, long long first, long long n) {
+    pool->firstSimulation = first;
+    pool->numSimulations = n;
+    // the chunks are numbered in 32 bits, past 2^32 chunks of STEAL_CHUNK
+    // simulations (about 10^12) they get twice as large as needed
+    pool->chunkSize = STEAL_CHUNK;
+    while ((n + pool->chunkSize - 1) / pool->chunkSize > UINT_MAX) {
+        pool->chunkSize *= 2;
+    }
+
+    // deal the chunks out evenly, the threads steal from each other once theirs are done
+    int numThreads = pool->numWorkers;
+    unsigned int numChunks = (n + pool->chunkSize - 1) / pool->chunkSize;
+    for (int i=0; i<numThreads; i++) {
+        atomic_init(&pool->workers[i].range, packRange((unsigned long long)numChunks * i / numThreads,
+                                                       (unsigned long long)numChunks * (i + 1) / numThreads));
+    }
+
+    pthread_t threads[numThreads];
+    for (int i=0; i<numThreads; i++) {
+        if (pthread_create(&threads[i], NULL, stealingSimulation, &pool->workers[i]) != 0) {
+            perror("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    long long sum = 0;
+    for (int i=0; i<numThreads; i++) {
+        pthread_join(threads[i], NULL);
+        sum += pool->workers[i].successes;
+    }
+    return sum;
+}
+
+void stealingPool_tallies(struct stealingPool* pool, struct tallies* t) {
+    tallies_init(t);
+    for (int i=0; i<pool->numWorkers; i++) {
+        if (pool->workers[i].started) {
+            tallies_merge(t, &pool->workers[i].w.tallies);
+        }
+    }
+}
+
+void stealingPool_histogram(struct stealingPool* pool, long long* histogram) {
+    for (int i=0; i<pool->numWorkers; i++) {
+        if (pool->workers[i].started) {
+            for (long long j=0; j<histogramSize(); j++) {
+                histogram[j] += pool->workers[i].w.histogram[j];
+            }
+        }
+    }
+}
+
+void stealingPool_free(struct stealingPool* pool) {
+    for (int i=0; i<pool->numWorkers; i++) {
+        if (pool->workers[i].started) {
+            workspace_free(&pool->workers[i].w);
+        }
+    }
+    free(pool->workers);
+}
+
+void simulateAndStatsWithThreads(long long n, int numThreads) {
+    struct stealingPool pool;
+    stealingPool_init(&pool, numThreads);
+    long long sum = stealingPool_run(&pool, 0, n);
+    for (int i=0; i<numThreads; i++) {
+        printf("Thread %d, number of simulations performed: %lld\n", i + 1, pool.workers[i].performed);
+    }
+    struct tallies t;
+    stealingPool_tallies(&pool, &t);
+    long long* histogram = histogramMode ? calloc(histogramSize(), sizeof(long long)) : NULL;
+    if (histogramMode) {
+        if (histogram == NULL) {
+            perror("Couldn't allocate the histograms");
+            exit(EXIT_FAILURE);
+        }
+        stealingPool_histogram(&pool, histogram);
+    }
+    stealingPool_free(&pool);
+    printResults(sum, n, &t, "All threads");
+    if (histogramMode) {
+        printHistograms(histogram, n);
+        free(histogram);
+    }
+}
+
+// variance of one simulation after "sum" successes in n, plus the 1/n of the
+// Chow-Robbins rule, which keeps a run from stopping while the estimate is
+// still stuck at 0 or 1 and its variance looks like 0
+static double sequentialVariance(long long sum, long long n) {
+    double mean = sum / (n + 0.0);
+    return (sum*(1 - mean))/(n-1) + 1.0/n;
+}
+
+// one round of simulateToHalfwidth with processes, the simulations [first, first + n)
+// are split evenly between them. Their workspaces are in shared memory, so the
+// PRNG state of each process carries over to its next round.
+static long long simulateRoundWithProcesses(struct workspace* workspaces, long long* successes,
+                                            long long first, long long n, int numProcesses) {
+    fflush(stdout); // or the children would print it again
+    for (int i=0; i<numProcesses; i++) {
+        int pid = fork();
+        if (pid == 0) { // children
+            // the first n % numProcesses processes perform one more simulation
+            long long begin = first + n / numProcesses * i + (i < n % numProcesses ? i : n % numProcesses);
+            long long end = begin + n / numProcesses + (i < n % numProcesses);
+            workspace_init(&workspaces[i], engine, numPrisoners);
+            successes[i] = simulateRange(&workspaces[i], begin, end - begin);
+            workspace_free(&workspaces[i]);
+            exit(EXIT_SUCCESS);
+        }
+        else if (pid < 0) { // failed
+            perror("fork failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    while (wait(NULL) > 0); // let parent wait for all children processes to exit
+
+    long long sum = 0;
+    for (int i=0; i<numProcesses; i++) {
+        sum += successes[i];
+    }
+    return sum;
+}
+
+void rounds_init(struct rounds* r, char mode, int numWorkers) {
+    r->mode = mode;
+    r->numWorkers = numWorkers;
+    r->workspaces = NULL;
+    r->successes = NULL;
+    tallies_init(&r->tallies);
+    if (mode == 's') {
+        r->caller = "Sequence (Single Thread / Process)";
+        workspace_init(&r->w, engine, numPrisoners);
+        seed(&r->w.rng, 0);
+    }
+    else if (mode == 't') {
+        r->caller = "All threads";
+        stealingPool_init(&r->pool, numWorkers);
+    }
+    else {
+        r->caller = "All processes";
+        r->workspaces = mmap(NULL, sizeof(struct workspace)*numWorkers,
+                             PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+        r->successes = mmap(NULL, sizeof(long long)*numWorkers,
+                            PROT_WRITE|PROT_READ, MAP_ANON|MAP_SHARED, -1, 0);
+        if (r->workspaces == MAP_FAILED || r->successes == MAP_FAILED) {
+            perror("Couldn't share memory with the processes");
+            exit(EXIT_FAILURE);
+        }
+        for (int i=0; i<numWorkers; i++) {
+            seed(&r->workspaces[i].rng, i); // the same streams as simulateAndStatsWithProcesses
+        }
+    }
+}
+
+long long rounds_run(struct rounds* r, long long first, long long n) {
+    long long sum;
+    if (r->mode == 's') {
+        sum = simulateRange(&r->w, first, n);
+        r->tallies = r->w.tallies;
+    }
+    else if (r->mode == 't') {
+        sum = stealingPool_run(&r->pool, first, n);
+        stealingPool_tallies(&r->pool, &r->tallies);
+    }
+    else {
+        sum = simulateRoundWithProcesses(r->workspaces, r->successes, first, n, r->numWorkers);
+        for (int i=0; i<r->numWorkers; i++) { // the children start every round from empty sums
+            tallies_merge(&r->tallies, &r->workspaces[i].tallies);
+        }
+    }
+    return sum;
+}
+
+void rounds_free(struct rounds* r) {
+    if (r->mode == 's') {
+        workspace_free(&r->w);
+    }
+    else if (r->mode == 't') {
+        stealingPool_free(&r->pool);
+    }
+    else {
+        munmap(r->workspaces, sizeof(struct workspace)*r->numWorkers);
+        munmap(r->successes, sizeof(long long)*r->numWorkers);
+    }
+}
+
+long long simulateToHalfwidth(double target, char mode, int numWorkers) {
+    struct rounds r;
+    rounds_init(&r, mode, numWorkers);
+    long long sum = 0, n = 0, next = MIN_SEQUENTIAL_SIMULATIONS;
+    while (1) {
+        sum += rounds_run(&r, n, next - n);
+        n = next;
+
+        // with control variates or -r, the rule stops on the variance of their estimate
+        double var = sequentialVariance(sum, n);
+        double estimate = sum / (n + 0.0);
+        if (controlVariates) {
+            control_variate_estimate(&r.tallies.cv, &estimate, &var);
+            var += 1.0/n;
+        }
+        else if (conditionalCycles > 0) {
+            conditionalEstimate(&r.tallies, &estimate, &var);
+            var += 1.0/n;
+        }
+        double halfwidth = 1.96*sqrt(var/n);
+        printf("%lld simulations, estimate %f, half-width %f\n", n, estimate, halfwidth);
+        if (halfwidth <= target) {
+            break;
+        }
+        if (n == LLONG_MAX) {
+            fprintf(stderr, "Stopped at %lld simulations, the most a run can count, before reaching the half-width\n", n);
+            break;
+        }
+        // check next at the number of simulations the current variance needs,
+        // at least 1/16 more so the rounds don't get too short, and at most twice
+        // as many in case the variance of the first rounds is still off
+        double needed = (1.96/target)*(1.96/target)*var;
+        double want = fmin(fmax(needed, n*1.0625), 2.0*n);
+        next = want >= LLONG_MAX ? LLONG_MAX : (long long)ceil(want);
+    }
+    rounds_free(&r);
+    printResults(sum, n, &r.tallies, r.caller);
+    return n;
+}
+
+// sets strataFirst to the simulations of a round that starts at "first",
+// count[h] of them in stratum h
+static void setStrataFirst(long long first, const long long* count) {
+    strataFirst[0] = first;
+    for (int h=0; h<numStrata; h++) {
+        strataFirst[h + 1] = strataFirst[h] + count[h];
+    }
+}
+
+void simulateStratified(long long n, char mode, int numWorkers) {
+    // 2 simulations per stratum and round at least, see strata_allocate
+    if (n < 4 * numStrata) {
+        fprintf(stderr, "The stratified engine needs at least %d simulations, 4 per stratum\n", 4 * numStrata);
+        exit(EXIT_FAILURE);
+    }
+    long long pilot = n / 10;
+    pilot = pilot < 2 * numStrata ? 2 * numStrata : pilot > n - 2 * numStrata ? n - 2 * numStrata : pilot;
+
+    struct rounds r;
+    rounds_init(&r, mode, numWorkers);
+    long long count[MAX_STRATA];
+    strata_allocate(NULL, strataWeight, numStrata, pilot, count);
+    setStrataFirst(0, count);
+    long long sum = rounds_run(&r, 0, pilot);
+
+    strata_allocate(&r.tallies.strata, strataWeight, numStrata, n - pilot, count);
+    setStrataFirst(pilot, count);
+    sum += rounds_run(&r, pilot, n - pilot);
+    rounds_free(&r);
+    printResults(sum, n, &r.tallies, r.caller);
+}
+
+// the histogram of the thread or process of p in the shared array, NULL without --histogram
+static long long* histogramSlice(struct simParam* p) {
+    return p->histograms == NULL ? NULL : p->histograms + p->taskNum * histogramSize();
 }
 
 void* splitSimulation(struct simParam* p) {
     // specify whether this function is being called by thread or process,
     // specify their taskNum, and number of simulations they will perform
-    printf("%s %d, number of simulations to perform: %d\n",
+    printf("%s %d, number of simulations to perform: %lld\n",
            p->taskName, p->taskNum + 1, p->numSimulations);
 
     char nameAndNum[20]; // string variable to contain taskNume and taskNum
     int idealBufSize = snprintf(nameAndNum, sizeof(nameAndNum),
                                 "%s %d", p->taskName, p->taskNum + 1);
-    int sum;
+    long long sum;
     // if array of 20 char is not enough
     if (idealBufSize > sizeof(nameAndNum)) {
         char secondaryBuf[idealBufSize];
         snprintf(secondaryBuf, sizeof(secondaryBuf),
                  "%s %d", p->taskName, p->taskNum + 1);
-        sum = simulateAndStats(p->numSimulations, secondaryBuf);
+        sum = simulateAndStats(p->taskNum, p->firstSimulation, p->numSimulations,
+                               &p->tallies[p->taskNum], histogramSlice(p), secondaryBuf);
     }
     else {
-        sum = simulateAndStats(p->numSimulations, nameAndNum);
+        sum = simulateAndStats(p->taskNum, p->firstSimulation, p->numSimulations,
+                               &p->tallies[p->taskNum], histogramSlice(p), nameAndNum);
     }
     p->successes[p->taskNum] = sum; // store number of successes in respective location
 
@@ -3,12 +3,122 @@
 #include "union-find/union-find.h"
 #endif
 
+#ifndef UNION_BATCH
+#define UNION_BATCH
+#include "union-find/union-find-batch.h"
+#endif
+
+#ifndef ARENA
+#define ARENA
+#include "arena/arena.h"
+#endif
+
+#ifndef RNG
+#define RNG
+#include "rng/rng.h"
+#endif
+
+#ifndef CONTROL_VARIATES
+#define CONTROL_VARIATES
+#include "control-variates/control-variates.h"
+#endif
+
+#ifndef STRATIFIED
+#define STRATIFIED
+#include "stratified/stratified.h"
+#endif
+
+#ifndef PAIRED
+#define PAIRED
+#include "paired/paired.h"
+#endif
+
+/*
+ * Position in the buffer of an rng, copied into a local variable by the
+ * functions that draw many random numbers and stored back when they return.
+ * range is the word range of the backend of r, set to a constant by
+ * WITH_WORD_RANGE so the kernels divide by a constant.
+ */
+struct rng_cursor {
+    struct rng* r;
+    size_t index;
+    unsigned long long range;
+};
+
+/*
+ * Number, mean and sum of the squared deviations from the mean of some values,
+ * updated one value at a time (Welford) and merged pairwise (Chan et al.),
+ * so the variance doesn't cancel out like a sum of squares minus n times the
+ * squared mean does once n gets large.
+ */
+struct moments {
+    long long n;
+    double mean;
+    double m2; // sum of (value - mean)^2
+};
+
+/*
+ * Adds the statistics of the values of "from" to "to", eg. of every thread or process.
+ */
+void moments_merge(struct moments* to, const struct moments* from);
+
+/*
+ * Adds one value.
+ */
+static inline void moments_add(struct moments* m, double value) {
+    m->n++;
+    double delta = value - m->mean;
+    m->mean += delta / m->n;
+    m->m2 += delta * (value - m->mean);
+}
+
+/*
+ * Statistics that each thread or process gathers over its simulations, besides
+ * the number of successes, merged once they are done.
+ */
+struct tallies {
+    covariate_sums cv;         // covariates of each simulation, with -c
+    struct moments conditional; // conditional success probabilities, with -r
+    double logScale;           // the two sums below are divided by exp(logScale), with -e tilted
+    double weights;            // sum of the likelihood ratios of the simulations
+    double weightSquares;      // sum of their squares
+    strata_sums strata;        // simulations and successes of each stratum, with -e stratified
+    paired_sums paired;        // successes of each evaluator, with --paired
+};
+
+void tallies_init(struct tallies* t);
+
+/*
+ * Adds a likelihood ratio of exp(logRatio) to the weights of t, rescaling
+ * them so the largest ratio so far is 1, whatever its order of magnitude.
+ */
+void tallies_add_weight(struct tallies* t, double logRatio);
+
+/*
+ * Adds the statistics of "from" to "to".
+ */
+void tallies_merge(struct tallies* to, const struct tallies* from);
+
 /*
  * Simulates the 100 prisoners problem "n" times using the
  * best strategy and prints the statistics.
  *
+ * int stream is the number of the thread or process, 0 when sequential.
+ * It selects the stream of the run seed the PRNG draws from.
+ *
+ * int first is the index of the first simulation among all threads or
+ * processes. With the Philox PRNG it selects the random stream of each
+ * simulation, so simulation i gives the same result whichever thread or
+ * process performs it.
+ *
  * int n is the number of simulations to simulate the 100 prisoners problem
  *
+ * struct tallies* t is set to the statistics of the simulations other than
+ * the number of successes, see struct tallies
+ *
+ * long long* histogram is set to the histograms of the simulations with
+ * --histogram or --sweep, see printHistogram, and is unused without them
+ *
  * char* caller is the name of the function calling simulateAndStats.
  * This is used incase of debugging, to print statistics of all threads
  * or processes
@@ -16,7 +126,8 @@
  * The return value is the number of times the simulations succeeded,
  * or the number of times all prisoners found their tag number.
  */
-int simulateAndStats(int n, char* caller);
+long long simulateAndStats(int stream, long long first, long long n, struct tallies* t, long long* histogram,
+                           char* caller);
 
 /*
  * Simulates the 100 prisoners problem once using the
@@ -27,14 +138,107 @@ enum found_t {
     NOT_FOUND = 0,
     FOUND = 1,
 };
-enum found_t runSimulation(set_union* s);
+enum found_t runSimulation(struct rng* r, set_union* s);
+
+/*
+ * Simulates the 100 prisoners problem once using the
+ * cycle walk engine and returns success or failure.
+ *
+ * int* boxes and unsigned long long* visited are the buffers of
+ * cycle_simulation, reused across simulations so nothing is allocated
+ * per simulation.
+ */
+enum found_t runCycleSimulation(struct rng* r, int* boxes, unsigned long long* visited);
+
+/*
+ * Simulates the 100 prisoners problem BATCH_LANES times at once using the
+ * batched union find data structure.
+ * The return value is the number of those simulations that succeeded.
+ */
+int runBatchSimulation(struct rng* r, set_union_batch* s);
+
+/*
+ * Simulates the 100 prisoners problem once by sampling only the
+ * cycle lengths of the boxes with the Feller coupling,
+ * and returns success or failure.
+ */
+enum found_t runFellerSimulation(struct rng* r);
+
+/*
+ * Same as runCycleSimulation and runFellerSimulation, and also sets x to the
+ * covariates of the simulation, centered on their expected values: the number
+ * of cycles (expected value H(n)), the number of fixed points (1) and whether
+ * the first cycle is longer than the limit ((n - k) / n).
+ * The kernels stop as soon as the outcome is known, so each covariate is its
+ * expected value given the cycles walked, see setCovariates.
+ */
+enum found_t runCycleSimulationWithCovariates(struct rng* r, int* boxes, unsigned long long* visited, double* x);
+enum found_t runFellerSimulationWithCovariates(struct rng* r, double* x);
+
+/*
+ * Same as runCycleSimulation and runFellerSimulation, but never stops early:
+ * walks or samples every cycle of the permutation, sets *longest to the length
+ * of the longest one and returns the number of cycles, for --histogram.
+ * The simulation succeeds when *longest is at most the trial limit.
+ */
+int runCycleProfile(struct rng* r, int* boxes, unsigned long long* visited, int* longest);
+int runFellerProfile(struct rng* r, int* longest);
+
+/*
+ * Same as runCycleProfile and runFellerProfile, but stop once the cycles left
+ * can't be longer than the longest so far, for --sweep. They only return the
+ * number of cycles walked or sampled until then.
+ */
+int runCycleLongest(struct rng* r, int* boxes, unsigned long long* visited, int* longest);
+int runFellerLongest(struct rng* r, int* longest);
+
+/*
+ * Grows a random permutation from 1 to numPrisoners prisoners with the
+ * Chinese restaurant process, for --n-sweep, and adds 1 to successes[m] for
+ * every number of prisoners m of the sweep that succeeds opening
+ * m maxTrials / numPrisoners boxes each. cycleOf and cycleLength hold
+ * numPrisoners ints, the cycle of each prisoner and the length of each cycle.
+ * Returns whether all numPrisoners prisoners succeed opening maxTrials boxes.
+ */
+enum found_t runRestaurantSimulation(struct rng* r, int* cycleOf, int* cycleLength, long long* successes);
+
+/*
+ * Samples only the first cycles of a simulation with the Feller coupling, as
+ * many as selected with -r, and returns the exact probability that the boxes
+ * left have no cycle longer than the limit, or 0 if a sampled cycle already is.
+ * Its expected value is the success probability, like the outcome of
+ * runFellerSimulation (Rao-Blackwell), with a smaller variance and fewer
+ * random numbers.
+ */
+double runFellerConditional(struct rng* r);
+
+/*
+ * Samples the cycle lengths of a permutation with the Feller coupling, drawing
+ * each one from a distribution tilted towards the short cycles of permutations
+ * that succeed, and returns the log of its likelihood ratio to a uniformly
+ * random permutation. Every simulation succeeds, and the average of the
+ * likelihood ratios estimates the success probability (importance sampling).
+ */
+double runTiltedSimulation(struct rng* r);
 
 /*
- * Simulates the 100 prisoners problem once using a
- * naive approach and returns success or failure.
- * success in this function only occurs if all prisoners find their tag
+ * Simulates the 100 prisoners problem once with the Feller coupling, like
+ * runFellerSimulation, given that the cycle of the first box has a length
+ * uniform on [low, low + count), and returns success or failure.
+ */
+enum found_t runStratifiedSimulation(struct rng* r, int low, int count);
+
+/*
+ * Simulates the 100 prisoners problem once by letting every prisoner look for
+ * his tag with the strategy of --strategy, and returns success or failure.
+ * success in this function only occurs if all prisoners find their tag, so
+ * it stops at the first prisoner who doesn't.
+ *
+ * int* boxes holds as many elements as there are prisoners, and int* order
+ * twice as many, the numbers 0 to numPrisoners - 1 in any order first, which
+ * the random strategy leaves as they are, see workspace_init.
  */
-enum found_t runNaiveSimulation(void);
+enum found_t runStrategySimulation(struct rng* r, int* boxes, int* order);
 
 /*
  * Simulates each prisoner to look for his tag number
@@ -43,18 +247,20 @@ enum found_t runNaiveSimulation(void);
  * This prisoner is looking for the number prisonerNum.
  *
  * int boxes[] is the room of uniformly distributed boxes.
- * prisoner #prisonerNum is looking through 50 boxes in boxes[]
+ * prisoner #prisonerNum is looking through "limit" boxes in boxes[]
+ *
+ * int limit is the number of boxes the prisoner may open (50 by default)
  *
  * if prisoner #prisonerNum finds his tag, lookForTag returns 1
- * if the prisoner does not find his tag within 50 trails,
+ * if the prisoner does not find his tag within "limit" trails,
  * lookForTag returns 0
  */
-int lookForTag(int prisonerNum, int boxes[]);
+int lookForTag(int prisonerNum, int boxes[], int limit);
 
 /*
  * Prints the statistics of a simulation that ran "n" times.
  * The statistics include the estimated parameter, variance of the parameter,
- * and a 95% confidence interval.
+ * a 95% confidence interval, and the deviation from the exact probability.
  *
  * int sum is the number of successes that the simulation returned
  *
@@ -62,19 +268,227 @@ int lookForTag(int prisonerNum, int boxes[]);
  *
  * char* caller is the name of the thread / process that called printStats
  */
-void printStats(int sum, int n, char* caller);
+void printStats(long long sum, long long n, char* caller);
+
+/*
+ * Prints the statistics of a run that performed "n" simulations with "sum"
+ * successes and the tallies t: printStats, followed by printControlVariates
+ * with -c, or only printConditional with -r, printImportance with -e tilted,
+ * printStratified with -e stratified or printPaired with --paired.
+ */
+void printResults(long long sum, long long n, const struct tallies* t, char* caller);
+
+/*
+ * Prints the importance sampling estimate of -e tilted from "n" simulations,
+ * with its relative standard error,
+ * 95% CI, effective sample size (sum of the weights squared over the sum of
+ * the squared weights) and deviation from the exact probability.
+ * The probabilities are printed in scientific notation, they can be far
+ * smaller than a double.
+ */
+void printImportance(long long n, const struct tallies* t, char* caller);
+
+/*
+ * Sets *estimate to the mean of the conditional success probabilities of the
+ * tallies t of the simulations with -r, and *variance to their variance.
+ */
+void conditionalEstimate(const struct tallies* t, double* estimate, double* variance);
+
+/*
+ * Prints the statistics of the conditional estimator of -r, like printStats,
+ * with how many times smaller its variance is than the one of the plain
+ * estimator, p(1 - p) for the exact probability p.
+ */
+void printConditional(const struct tallies* t, char* caller);
+
+/*
+ * Prints the stratified estimate of -e stratified from the tallies t of "n"
+ * simulations, like printStats, with how many times smaller its variance is
+ * than the one of the plain estimator with as many simulations.
+ */
+void printStratified(const struct tallies* t, long long n, char* caller);
+
+/*
+ * Splits the lengths of the cycle of the first box that can succeed,
+ * 1 to the trial limit, into at most MAX_STRATA strata of equal widths,
+ * called once before simulating with -e stratified.
+ */
+void initStrata(void);
+
+/*
+ * Prints the histograms of "n" simulations with --histogram, the success
+ * curve computed from them with --sweep, or the one of --n-sweep.
+ */
+void printHistograms(const long long* histogram, long long n);
+
+/*
+ * Prints the success probability of "n" simulations for every trial limit
+ * from the histogram of their longest cycle, in one pass: the prisoners
+ * succeed exactly when they may open at least as many boxes as the longest
+ * cycle holds. Each limit gets its 95% CI, and its exact probability with
+ * the deviation in standard errors for up to MAX_EXACT_HISTOGRAM_PRISONERS
+ * prisoners. The limits where no simulation, or every simulation, succeeds
+ * are left out.
+ */
+void printSweep(const long long* histogram, long long n);
+
+/*
+ * Prints the success probability of "n" simulations of --n-sweep for every
+ * number of prisoners m of the sweep, each opening m maxTrials / numPrisoners
+ * boxes, from successes[m]: its 95% CI and its exact probability, with the
+ * deviation in standard errors for up to MAX_EXACT_HISTOGRAM_PRISONERS
+ * prisoners.
+ */
+void printNSweep(const long long* successes, long long n);
+
+/*
+ * Prints the line of printNSweep for m prisoners, who open m*maxTrials/numPrisoners
+ * boxes each.
+ */
+void printNSweepRow(const long long* successes, long long n, long long m);
+
+/*
+ * Prints the histograms of --histogram of "n" simulations: how many had each
+ * length of their longest cycle, along with its exact probability for up to
+ * MAX_EXACT_HISTOGRAM_PRISONERS prisoners, then how many had each number of
+ * cycles, and the mean of both.
+ *
+ * long long* histogram holds histogramSize() counts, the ones of the longest
+ * cycle lengths 0 to numPrisoners, then of the numbers of cycles 0 to numPrisoners.
+ */
+void printHistogram(const long long* histogram, long long n);
+
+/*
+ * Returns the number of counts of the histograms of --histogram.
+ */
+long long histogramSize(void);
+
+/*
+ * Prints the estimate of every evaluator of --paired from the tallies t, then
+ * the paired difference of each one with the first, its 95% CI, how many times
+ * smaller its variance is than the one of the difference of separate runs,
+ * and its deviation from the exact difference.
+ */
+void printPaired(const struct tallies* t, char* caller);
+
+/*
+ * Computes the tilt of the cycle lengths of the tilted engine for every
+ * number of boxes left, called once before simulating with -e tilted.
+ * Exits if there are too many prisoners or not enough memory.
+ */
+void initTilted(void);
+
+/*
+ * Computes the success probabilities of successTable for the number of
+ * prisoners and the trial limit, called once before simulating with -r.
+ * Exits if there are too many prisoners or not enough memory.
+ */
+void initSuccessTable(void);
+
+/*
+ * Prints the control variate estimate of the covariate sums cv, its 95% CI,
+ * how many times smaller its variance is than the variance printStats uses,
+ * and its deviation from the exact probability.
+ */
+void printControlVariates(const covariate_sums* cv);
+
+/*
+ * Precomputes the harmonic numbers and the expected values of the covariates
+ * for the number of prisoners and the trial limit, called once before simulating.
+ */
+void initCovariates(void);
+
+/*
+ * Returns the harmonic number H(m) = 1 + 1/2 + ... + 1/m, from a table or
+ * from its asymptotic expansion for m of HARMONIC_TABLE_SIZE or more.
+ */
+double harmonic(int m);
+
+/*
+ * Prints the exact probability that all prisoners find their tag number.
+ *
+ * long long prisoners is the number of prisoners and boxes
+ *
+ * long long trials is the number of boxes each prisoner may open
+ */
+void printExact(long long prisoners, long long trials);
 
 /*
  * Performs a single simulation of the 100 prisoners problem
  * using the union find data structure.
+ * struct rng* r is the PRNG that shuffles the boxes.
  * set_union* s is a pointer to the set of paths created
  *              from the randomization of the set of boxes.
- *              If a set is larger than 50, that means that
+ *              If a set is larger than limit, that means that
  *              at least 1 prisoner would need to inspect more
- *              than 50 boxes.
+ *              than limit boxes.
  * int size is the number of boxes.
+ * int limit is the number of boxes each prisoner may open.
  */
-enum found_t single_simulation(set_union* s, int size);
+enum found_t single_simulation(struct rng* r, set_union* s, int size, int limit);
+
+/*
+ * Performs a single simulation of the 100 prisoners problem
+ * by walking the cycles of the permutation.
+ * int* boxes is filled with a random permutation of [0, size),
+ *            then each cycle is walked once, marking the boxes
+ *            it visits in a bitmap. The walk stops as soon as a
+ *            cycle longer than limit is found, or once the boxes
+ *            left to visit are too few to hold such a cycle.
+ * unsigned long long* visited is the bitmap, with at least size bits.
+ * int size is the number of boxes.
+ * int limit is the number of boxes each prisoner may open.
+ */
+enum found_t cycle_simulation(struct rng* r, int* boxes, unsigned long long* visited, int size, int limit);
+
+/*
+ * Performs BATCH_LANES independent simulations of the 100 prisoners problem,
+ * one per vector lane of the batched union find data structure.
+ * Every lane draws its own random box at each step of the shuffle, and the
+ * batch stops as soon as every lane holds a set larger than limit.
+ * set_union_batch* s is the batch of sets, one per simulation.
+ * int size is the number of boxes.
+ * int limit is the number of boxes each prisoner may open.
+ * The return value is the number of lanes that succeeded.
+ */
+int batch_simulation(struct rng* r, set_union_batch* s, int size, int limit);
+
+/*
+ * Performs a single simulation of the 100 prisoners problem
+ * without building the permutation of the boxes.
+ * In the Feller coupling, independent Bernoulli(1/i) draws for i = 1..size,
+ * followed by a success at size+1, give the cycle lengths of a uniformly
+ * random permutation as the gaps between consecutive successes.
+ * Below a success at position i, the next success is uniform on [1, i-1],
+ * so each gap is drawn directly with one random number, from the top down.
+ * The simulation stops at the first gap longer than limit, or once the
+ * positions left are too few to hold such a gap.
+ * int size is the number of boxes.
+ * int limit is the number of boxes each prisoner may open.
+ */
+enum found_t feller_simulation(struct rng* r, int size, int limit);
+
+/*
+ * Performs a single simulation of the 100 prisoners problem
+ * with the Feller coupling, like feller_simulation, in the stratum of
+ * the permutations whose first box is in a cycle of length l.
+ * The gap at the top is set to l instead of drawn, then the size - l
+ * positions below it are drawn like feller_simulation.
+ * int size is the number of boxes.
+ * int limit is the number of boxes each prisoner may open.
+ * int length is l, from 1 to limit.
+ */
+enum found_t stratified_simulation(struct rng* r, int size, int limit, int length);
+
+/*
+ * Prints the elapsed time of a simulation that ran "n" times and the
+ * number of simulations per second, to compare the engines.
+ *
+ * int n is the number of simulations performed
+ *
+ * double seconds is the wall clock time the simulation took
+ */
+void printThroughput(long long n, double seconds);
 
 /*
  * Randomizes / shuffles the array using the Fisher-Yates (Knuth) shuffle
@@ -86,25 +500,70 @@ enum found_t single_simulation(set_union* s, int size);
  * Seminumerical Algorithms, 3rd ed. Boston, Massachusetts: Addison-Wesley Professional,
  * 1997, ch. 3, sec. 4.2, pp. 145
  *
+ * struct rng* r is the PRNG that draws the random numbers
+ *
  * int* array is the array to randomize / shuffle
  *
  * int size is the size of the array
  */
-void randomizeArray(int* array, int size);
+void randomizeArray(struct rng* r, int* array, int size);
 
 /*
  * Specifies the method / PRNG to return a random number
  *
+ * struct rng* r is the PRNG state to draw from, owned by the caller
+ *
  * int currentIndex is used to specify the range of the PRNG, in other words,
  * the PRNG will return a number in the range [0, currentIndex]
+ *
+ * Every PRNG goes through the same multiply-shift with rejection, which needs
+ * no hardware divide and has no modulo bias.
  */
-unsigned int randomInt(int currentIndex);
+unsigned int randomInt(struct rng* r, int currentIndex);
 
 /*
- * Seeds the random() function.
- * Using random() instead of rand() for better randomness.
+ * Precomputes the rejection thresholds of randomInt for small bounds and
+ * the word range of the selected backend, called once before simulating.
  */
-void seed(void);
+void initRandomInt(void);
+
+/*
+ * Seeds the PRNG state r with the backend selected with -g and the run seed,
+ * at stream number "stream", and empties its buffer.
+ * The MRG32k3a and dSFMT backends jump ahead to their stream, so no two threads
+ * or processes draw overlapping sequences. The Philox backend has a stream
+ * per simulation instead, see seedSimulation.
+ */
+void seed(struct rng* r, int stream);
+
+/*
+ * Moves the Philox PRNG r to the random stream of simulation number i,
+ * does nothing for the other backends.
+ */
+void seedSimulation(struct rng* r, long long i);
+
+/*
+ * Fills buf with "size" bytes read from /dev/urandom, exits on failure.
+ */
+void readUrandom(void* buf, size_t size);
+
+/*
+ * Simulates 100 prisoners problem "n" times using numThreads threads.
+ *
+ * The simulations are split in chunks of STEAL_CHUNK, and every thread starts
+ * with an equal range of them. A thread takes the chunks of its own range one
+ * by one, and once it runs out, steals the last half of the range of another
+ * thread, so threads that finish early keep working until no chunk is left.
+ * Each range is a single atomic word, so taking and stealing need no lock.
+ *
+ * Each thread has its own workspace and PRNG state, and counts its successes
+ * in its own cache line; they are summed once every thread has joined.
+ *
+ * int n is the total number of simulations to be performed
+ *
+ * int numThreads is the number of threads to create
+ */
+void simulateAndStatsWithThreads(long long n, int numThreads);
 
 /*
  * Simulates 100 prisoners problem "n" times using numProcesses processes.
@@ -118,7 +577,40 @@ void seed(void);
  *
  * eg. if n == 100, and numProcesses == 4, then each process performes 100/4 = 25 simulations
  */
-void simulateAndStatsWithProcesses(int n, int numProcesses);
+void simulateAndStatsWithProcesses(long long n, int numProcesses);
+
+/*
+ * Simulates the 100 prisoners problem until the 95% confidence interval of
+ * the estimate is at most "target" wide on each side, then prints the statistics.
+ *
+ * The simulations run in rounds, sequentially (mode 's'), with numWorkers
+ * threads ('t') or with numWorkers processes ('p'), and every thread or process
+ * keeps drawing from its own PRNG stream from one round to the next. After each
+ * round the Chow-Robbins rule stops at the first n where
+ * 1.96 * sqrt((s^2 + 1/n) / n) <= target, s^2 being the variance estimate.
+ * Stopping where the usual interval gets narrow enough would stop early when s^2
+ * is too small by chance, the 1/n term keeps the coverage at 95% as target
+ * shrinks. The next round ends where the current s^2 says the target is reached.
+ *
+ * The return value is the number of simulations performed.
+ */
+long long simulateToHalfwidth(double target, char mode, int numWorkers);
+
+/*
+ * Simulates the 100 prisoners problem "n" times with -e stratified, then
+ * prints the statistics.
+ *
+ * The first round, a tenth of the simulations, is allocated to the strata
+ * in proportion to their probabilities, and the second round to minimize the
+ * variance given the success rates of the first (Neyman allocation), see
+ * stratified.h. The strata whose first cycle is longer than the trial limit
+ * always fail, so they get no simulations.
+ * The rounds run sequentially (mode 's'), with numWorkers threads ('t')
+ * or with numWorkers processes ('p'), like simulateToHalfwidth.
+ *
+ * Exits if n is too small to give every stratum 2 simulations in each round.
+ */
+void simulateStratified(long long n, char mode, int numWorkers);
 
 /*
  * The threads or processes take a parameter to call the
@@ -127,9 +619,12 @@ void simulateAndStatsWithProcesses(int n, int numProcesses);
 struct simParam {
     char* taskName; // name of caller, name could be either Thread or Process
     int taskNum;    // the number or id of each thread or process, eg. Thread 1 / Process 3
-    int* successes; // shared array to store number of successes in their respective location.
-                    // their respective location is index of their number, their threadOrProcessNum
-    int numSimulations; // number of simulations for this thread or process to simulate.
+    long long* successes; // shared array to store number of successes in their respective location.
+                          // their respective location is index of their number, their threadOrProcessNum
+    long long numSimulations; // number of simulations for this thread or process to simulate.
+    long long firstSimulation; // index of the first of those simulations among all threads or processes.
+    struct tallies* tallies; // shared array of the other statistics of each thread or process, like successes
+    long long* histograms;   // shared array of the histograms of each thread or process, with --histogram or --sweep
 };
 
 /*
@@ -137,4 +632,271 @@ struct simParam {
  */
 void* splitSimulation(struct simParam* p);
 
+/*
+ * Engines that simulateAndStats can use to perform each simulation.
+ * UNION_FIND_ENGINE merges the sets of boxes at every step of the shuffle,
+ * CYCLE_WALK_ENGINE shuffles the boxes first and walks their cycles after.
+ * BATCH_UNION_FIND_ENGINE runs the union find engine on BATCH_LANES
+ * simulations at once with vector instructions.
+ * FELLER_ENGINE samples the cycle lengths directly without any boxes.
+ * TILTED_ENGINE samples them from a distribution where every simulation
+ * succeeds instead, and weights each by its likelihood ratio (importance sampling).
+ * STRATIFIED_ENGINE samples them given the length of the first cycle, set
+ * by the stratum of each simulation.
+ * PAIRED_ENGINE shuffles the boxes once per simulation and judges them with
+ * every evaluator of --paired, it is selected by --paired instead of -e.
+ * RESTAURANT_ENGINE grows the permutation one prisoner at a time to judge
+ * every number of prisoners of --n-sweep at once, it is selected by --n-sweep.
+ * STRATEGY_ENGINE shuffles the boxes and lets every prisoner look for his tag
+ * with a strategy of enum strategy_t, it is selected by --strategy.
+ */
+enum engine_t {
+    UNION_FIND_ENGINE,
+    CYCLE_WALK_ENGINE,
+    BATCH_UNION_FIND_ENGINE,
+    FELLER_ENGINE,
+    TILTED_ENGINE,
+    STRATIFIED_ENGINE,
+    PAIRED_ENGINE,
+    RESTAURANT_ENGINE,
+    STRATEGY_ENGINE,
+};
+
+/*
+ * Strategies the prisoners of --strategy look for their tag with.
+ * CYCLE_STRATEGY opens his own box first, then the box of the number found
+ * in the previous one, like lookForTag.
+ * RANDOM_STRATEGY opens distinct boxes drawn at random.
+ * WINDOW_STRATEGY opens the boxes from his own one on, wrapping around.
+ * CUSTOM_STRATEGY opens the boxes picked by custom_first_box and
+ * custom_next_box in 100prisoners.c, to be edited for a strategy of your own.
+ */
+enum strategy_t {
+    CYCLE_STRATEGY,
+    RANDOM_STRATEGY,
+    WINDOW_STRATEGY,
+    CUSTOM_STRATEGY,
+};
+
+#define NUM_STRATEGIES 4
+
+/*
+ * Sets *s to the strategy named "name" ("cycle", "random", "window" or "custom").
+ * Returns 0 on success and -1 if the name is unknown.
+ */
+int parseStrategy(const char* name, enum strategy_t* s);
+
+/*
+ * Returns the exact probability that every prisoner finds his tag with
+ * strategy s, or NAN if it isn't known: the one of exact_probability for the
+ * cycle strategy, and (k/n)^n for the random one.
+ */
+double strategyProbability(enum strategy_t s);
+
+/*
+ * Runs "n" simulations sequentially with every strategy in turn, on the same
+ * permutations of the boxes, and prints the statistics and the number of
+ * simulations per second of each one.
+ */
+void benchmarkStrategies(long long n);
+
+/*
+ * Sets *e to the engine named "name" ("union", "cycle", "batch", "feller", "tilted"
+ * or "stratified"). "batch" falls back to "union" when compiled without AVX2
+ * or AVX-512, where it would only be slower.
+ * Returns 0 on success and -1 if the name is unknown.
+ */
+int parseEngine(const char* name, enum engine_t* e);
+
+/*
+ * Ways --paired can judge a permutation of the boxes, each with a trial limit.
+ * CYCLE_EVALUATOR walks its cycles like the cycle walk engine,
+ * NAIVE_EVALUATOR lets every prisoner look for his tag with lookForTag, and
+ * UNION_EVALUATOR merges every box with the box its number points to in a
+ * union find data structure, stopping at the first set larger than the limit.
+ */
+enum evaluator_t {
+    CYCLE_EVALUATOR,
+    NAIVE_EVALUATOR,
+    UNION_EVALUATOR,
+};
+
+struct evaluator {
+    enum evaluator_t kind;
+    long long limit; // number of boxes each prisoner may open, 0 for the one of -k
+};
+
+/*
+ * Sets e to the comma separated list of evaluators "list", each "cycle",
+ * "naive" or "union", followed by ":k" for a trial limit other than the one
+ * of -k, eg. "cycle,cycle:45" or "cycle,naive,union".
+ * Returns the number of evaluators, or -1 if the list is invalid or holds
+ * fewer than 2 or more than MAX_EVALUATORS of them.
+ */
+int parseEvaluators(const char* list, struct evaluator* e);
+
+/*
+ * Buffers that one thread or process reuses across all of its simulations.
+ * They are carved out of a single arena allocated up front, so simulating
+ * never calls malloc, whatever the number of prisoners.
+ */
+struct workspace {
+    arena memory;                // block holding every buffer below
+    set_union s;                 // sets of the union find engine
+    set_union_batch batch;       // sets of the batched union find engine
+    int* boxes;                  // permutation of the cycle walk engine and of the strategies
+    unsigned long long* visited; // bitmap of the cycle walk engine
+    int* order;                  // boxes in the order of the random strategy, then its swaps
+    int* cycleOf;                // cycle of every prisoner of the restaurant engine
+    int* cycleLength;            // length of every cycle of the restaurant engine
+    struct rng rng;              // PRNG of this thread or process
+    struct tallies tallies;      // statistics of the simulations since workspace_init
+    long long* histogram;        // histograms of the simulations since workspace_init, with --histogram or --sweep
+};
+
+/*
+ * Allocates the buffers that engine "e" needs to simulate "size" prisoners.
+ * Exits if the memory can't be allocated.
+ */
+void workspace_init(struct workspace* w, enum engine_t e, int size);
+
+void workspace_free(struct workspace* w);
+
+/*
+ * Shuffles the boxes of w once, and sets y[i] to the success (1) or failure (0)
+ * of evaluator i of --paired on them, for every evaluator.
+ */
+void runPairedSimulation(struct rng* r, struct workspace* w, int* y);
+
+/*
+ * Performs "n" simulations of the 100 prisoners problem with the buffers and
+ * PRNG of w, numbered from "first" like in simulateAndStats.
+ * The return value is the number of simulations that succeeded.
+ */
+long long simulateRange(struct workspace* w, long long first, long long n);
+
+/*
+ * A thread of a stealingPool, aligned to its own cache line so
+ * the threads never write to the same line.
+ */
+struct stealingWorker {
+    _Atomic unsigned long long range; // chunks [begin, end) left, begin in the high 32 bits
+    int id;                           // index of the thread in the pool
+    long long successes;              // number of successes, written once the thread is done
+    long long performed;              // number of simulations the thread performed in the last run
+    int started;                      // set once the thread has initialized w
+    struct stealingPool* pool;
+    struct workspace w;               // buffers and PRNG state of the thread, kept from run to run
+} __attribute__((aligned(64)));
+
+/*
+ * Threads of simulateAndStatsWithThreads, which steal chunks from each other.
+ */
+struct stealingPool {
+    struct stealingWorker* workers;
+    int numWorkers;
+    long long firstSimulation; // index of the first simulation of the current run
+    long long numSimulations;  // number of simulations of the current run
+    long long chunkSize;       // simulations per chunk of the current run, see stealingPool_run
+};
+
+/*
+ * Allocates the workers of a pool of numThreads threads, exits on failure.
+ * Each thread initializes its workspace and seeds its PRNG at stream number
+ * id the first time it runs, and keeps them until stealingPool_free.
+ */
+void stealingPool_init(struct stealingPool* pool, int numThreads);
+
+/*
+ * Performs the simulations [first, first + n) with the threads of the pool,
+ * and returns the number of them that succeeded. The pool can run again,
+ * every thread then continues its own PRNG stream where it stopped.
+ */
+long long stealingPool_run(struct stealingPool* pool, long long first, long long n);
+
+/*
+ * Sets t to the tallies of every simulation the threads of the pool performed.
+ */
+void stealingPool_tallies(struct stealingPool* pool, struct tallies* t);
+
+/*
+ * Adds the histograms of every simulation the threads of the pool performed
+ * to histogram, with --histogram.
+ */
+void stealingPool_histogram(struct stealingPool* pool, long long* histogram);
+
+void stealingPool_free(struct stealingPool* pool);
+
+/*
+ * Threads, processes or the single workspace of a run that performs its
+ * simulations in rounds, like simulateToHalfwidth and simulateStratified.
+ */
+struct rounds {
+    char mode;                    // 's' sequentially, 't' with threads or 'p' with processes
+    int numWorkers;               // number of threads or processes
+    char* caller;                 // name of the run for printResults
+    struct workspace w;           // of the sequential run
+    struct stealingPool pool;     // of the threads
+    struct workspace* workspaces; // of the processes, shared with them
+    long long* successes;         // of the processes, shared with them
+    struct tallies tallies;       // of every round so far
+};
+
+/*
+ * Prepares the threads, processes or workspace of mode, with numWorkers
+ * threads or processes. Each one seeds its PRNG at its stream number once,
+ * and keeps drawing from it from one round to the next.
+ * Exits if the memory can't be allocated or shared.
+ */
+void rounds_init(struct rounds* r, char mode, int numWorkers);
+
+/*
+ * Performs the simulations [first, first + n), adds their statistics to
+ * r->tallies and returns the number of them that succeeded.
+ */
+long long rounds_run(struct rounds* r, long long first, long long n);
+
+void rounds_free(struct rounds* r);
+
+/*
+ * Simulates the chunks of the stealingWorker "arg" and the chunks it steals,
+ * until every chunk of its pool is taken.
+ */
+void* stealingSimulation(void* arg);
+
+/*
+ * Simulation kernels for one number of prisoners, trial limit and PRNG word range.
+ * Each performs a single simulation with its engine and returns success
+ * or failure, like runSimulation, runCycleSimulation and runStrategySimulation,
+ * or BATCH_LANES simulations for batch, like runBatchSimulation.
+ */
+struct kernels {
+    enum found_t (*union_find)(struct rng* r, set_union* s);
+    enum found_t (*cycle_walk)(struct rng* r, int* boxes, unsigned long long* visited);
+    enum found_t (*strategy)(struct rng* r, int* boxes, int* order);
+    int (*batch)(struct rng* r, set_union_batch* s);
+    enum found_t (*feller)(struct rng* r);
+    enum found_t (*cycle_walk_covariates)(struct rng* r, int* boxes, unsigned long long* visited, double* x);
+    enum found_t (*feller_covariates)(struct rng* r, double* x);
+    double (*feller_conditional)(struct rng* r);
+    double (*tilted)(struct rng* r);
+    enum found_t (*stratified)(struct rng* r, int low, int count);
+    int (*cycle_walk_profile)(struct rng* r, int* boxes, unsigned long long* visited, int* longest);
+    int (*feller_profile)(struct rng* r, int* longest);
+    int (*cycle_walk_longest)(struct rng* r, int* boxes, unsigned long long* visited, int* longest);
+    int (*feller_longest)(struct rng* r, int* longest);
+    enum found_t (*restaurant)(struct rng* r, int* cycleOf, int* cycleLength, long long* successes);
+};
+
+/*
+ * Selects the kernels for "size" prisoners opening "limit" boxes each,
+ * drawing from a PRNG backend whose words are uniform on [0, range).
+ * The common pairs, 100/50, 1000/500 and 64/32, get kernels specialized at
+ * compile time that use fixed size buffers on the stack and constant bounds.
+ * Any other pair gets the generic kernels, which use the buffers passed in.
+ * Every kernel is compiled once per word range, so none of them checks
+ * the backend while it simulates.
+ */
+void selectKernels(struct kernels* k, int size, int limit, unsigned long long range);
+
 void printUsage(void);
@@ -4,20 +4,32 @@
 #define ARRAY_SIZE (1 << 8)
 
 typedef unsigned char Uc;
-static Uc c;
-static unsigned int t[ARRAY_SIZE];
 
-void Lfib4_seed(unsigned char seedVal, unsigned int* a) {
-    c = seedVal;
+void Lfib4_seed(lfib4_t* g, unsigned char seedVal, unsigned int* a) {
+    g->c = seedVal;
 
     for (int i = 0; i < ARRAY_SIZE; i++) {
-        t[i] = a[i];
+        g->t[i] = a[i];
     }
 }
 
-unsigned int Lfib4(void) {
+unsigned int Lfib4(lfib4_t* g) {
+    unsigned int* t = g->t;
+    Uc c = g->c;
     t[c]=t[c]+t[(Uc)(c+58)]+t[(Uc)(c+119)]+t[(Uc)(c+179)];
-    return t[++c];
+    g->c = ++c;
+    return t[c];
+}
+
+void Lfib4_fill(lfib4_t* g, unsigned int* restrict a, int n) {
+    unsigned int* restrict t = g->t;
+    Uc i = g->c; // keep the index in a register instead of the state
+
+    for (int j=0; j<n; j++) {
+        t[i]=t[i]+t[(Uc)(i+58)]+t[(Uc)(i+119)]+t[(Uc)(i+179)];
+        a[j] = t[++i];
+    }
+    g->c = i;
 }
 
 /* test
@@ -27,14 +39,15 @@ int main() {
     fread(&seedVal, sizeof(seedVal), 1, urandom);
     unsigned int a[ARRAY_SIZE];
     fread(a, sizeof(unsigned int), ARRAY_SIZE, urandom);
-    Lfib4_seed(seedVal, a);
-    printf("c=%u\n", c);
+    lfib4_t g;
+    Lfib4_seed(&g, seedVal, a);
+    printf("c=%u\n", g.c);
     for (int i = 0; i < ARRAY_SIZE; i++) {
-        printf("t[%d]=%u\n", i, t[i]);
+        printf("t[%d]=%u\n", i, g.t[i]);
     }
 
     for (int i = 0; i < 10; i++) {
-        printf("%u\n", Lfib4());
+        printf("%u\n", Lfib4(&g));
     }
     return 0;
 }
@@ -1,2 +1,16 @@
-void Lfib4_seed(unsigned char seedVal, unsigned int* a);
-unsigned int Lfib4(void);
+/*
+ * State of one Lfib4 generator. Each caller owns its own state,
+ * so several threads can draw from their own generators without locks.
+ */
+typedef struct {
+    unsigned char c;      // index of the next element of t to update
+    unsigned int t[256];  // lagged values
+} lfib4_t;
+
+void Lfib4_seed(lfib4_t* g, unsigned char seedVal, unsigned int* a);
+unsigned int Lfib4(lfib4_t* g);
+
+/*
+ * Fills a[0..n-1] with the next n values of Lfib4().
+ */
+void Lfib4_fill(lfib4_t* g, unsigned int* a, int n);
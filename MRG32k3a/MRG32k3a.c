@@ -23,51 +23,147 @@ The seeds for s10, s11, s12 must be integers in [0, m1 - 1] and not all 0.
 The seeds for s20, s21, s22 must be integers in [0, m2 - 1] and not all 0. 
 ***/
 
-static double s10, s11, s12,
-              s20, s21, s22;
-
-void mrg_seed(unsigned int s10p, unsigned int s11p, unsigned int s12p,
+void mrg_seed(mrg_t* g,
+              unsigned int s10p, unsigned int s11p, unsigned int s12p,
               unsigned int s20p, unsigned int s21p, unsigned int s22p) {
 
     unsigned int lm1 = m1, lm2 = m2;
 
     // adding 1 to each seed to guarantee all seeds will never be 0
-    s10 = (s10p % lm1)+1; s11 = (s11p % lm1)+1; s12 = (s12p % lm1)+1;
-    s20 = (s20p % lm2)+1; s21 = (s21p % lm2)+1; s22 = (s22p % lm2)+1;
+    g->s10 = (s10p % lm1)+1; g->s11 = (s11p % lm1)+1; g->s12 = (s12p % lm1)+1;
+    g->s20 = (s20p % lm2)+1; g->s21 = (s21p % lm2)+1; g->s22 = (s22p % lm2)+1;
 }
 
-void mrg_seed_array(unsigned int* a) {
-    mrg_seed(a[0], a[1], a[2],
-             a[3], a[4], a[5]);
+void mrg_seed_array(mrg_t* g, unsigned int* a) {
+    mrg_seed(g, a[0], a[1], a[2],
+                a[3], a[4], a[5]);
 }
 
-double MRG32k3a (void)
+static inline unsigned int mrg_step (mrg_t* g)
 {
    long k;
    double p1, p2;
    /* Component 1 */
-   p1 = a12 * s11 - a13n * s10;
+   p1 = a12 * g->s11 - a13n * g->s10;
    k = p1 / m1;
    p1 -= k * m1;
    if (p1 < 0.0)
       p1 += m1;
-   s10 = s11;
-   s11 = s12;
-   s12 = p1;
+   g->s10 = g->s11;
+   g->s11 = g->s12;
+   g->s12 = p1;
 
    /* Component 2 */
-   p2 = a21 * s22 - a23n * s20;
+   p2 = a21 * g->s22 - a23n * g->s20;
    k = p2 / m2;
    p2 -= k * m2;
    if (p2 < 0.0)
       p2 += m2;
-   s20 = s21;
-   s21 = s22;
-   s22 = p2;
+   g->s20 = g->s21;
+   g->s21 = g->s22;
+   g->s22 = p2;
 
-   /* Combination */
+   /* Combination, in [1, m1], shifted to [0, m1 - 1] */
    if (p1 <= p2)
-      return ((p1 - p2 + m1) * norm);
+      return (unsigned int)(p1 - p2 + m1) - 1;
    else
-      return ((p1 - p2) * norm);
+      return (unsigned int)(p1 - p2) - 1;
+}
+
+unsigned int MRG32k3a_uint (mrg_t* g)
+{
+   return mrg_step(g);
+}
+
+void MRG32k3a_fill_uint (mrg_t* g, unsigned int* a, int n)
+{
+   mrg_t local = *g; // a local copy of the state stays in registers
+   for (int i=0; i<n; i++)
+      a[i] = mrg_step(&local);
+   *g = local;
+}
+
+double MRG32k3a (mrg_t* g)
+{
+   return (MRG32k3a_uint(g) + 1.0) * norm;
+}
+
+/***
+Jump-ahead matrices: A1p76 = A1^(2^76) mod m1 and A2p76 = A2^(2^76) mod m2
+move the state 2^76 steps ahead, A1p127 and A2p127 2^127 steps ahead, where
+A1 and A2 are the transition matrices of the two components.
+***/
+static const unsigned long long A1p76[3][3] = {
+   {   82758667, 1871391091, 4127413238 },
+   { 3672831523,   69195019, 1871391091 },
+   { 3672091415, 3528743235,   69195019 }
+};
+static const unsigned long long A2p76[3][3] = {
+   { 1511326704, 3759209742, 1610795712 },
+   { 4292754251, 1511326704, 3889917532 },
+   { 3859662829, 4292754251, 3708466080 }
+};
+static const unsigned long long A1p127[3][3] = {
+   { 2427906178, 3580155704,  949770784 },
+   {  226153695, 1230515664, 3580155704 },
+   { 1988835001,  986791581, 1230515664 }
+};
+static const unsigned long long A2p127[3][3] = {
+   { 1464411153,  277697599, 1610723613 },
+   {   32183930, 1464411153, 1022607788 },
+   { 2824425944,   32183930, 2093834863 }
+};
+
+/* c = a * b mod m, the entries are below 2^32 so each product fits in 64 bits */
+static void mat_mul (const unsigned long long a[3][3], const unsigned long long b[3][3],
+                     unsigned long long c[3][3], unsigned long long m)
+{
+   unsigned long long t[3][3];
+   for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+         t[i][j] = (a[i][0] * b[0][j] % m + a[i][1] * b[1][j] % m + a[i][2] * b[2][j] % m) % m;
+   for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++)
+         c[i][j] = t[i][j];
+}
+
+/* v = a * v mod m */
+static void mat_vec (const unsigned long long a[3][3], double* v0, double* v1, double* v2,
+                     unsigned long long m)
+{
+   unsigned long long v[3] = { *v0, *v1, *v2 }, t[3];
+   for (int i=0; i<3; i++)
+      t[i] = (a[i][0] * v[0] % m + a[i][1] * v[1] % m + a[i][2] * v[2] % m) % m;
+   *v0 = t[0]; *v1 = t[1]; *v2 = t[2];
+}
+
+/* moves both components n times by their jump matrices, with binary powering */
+static void mrg_jump (mrg_t* g, const unsigned long long j1[3][3],
+                      const unsigned long long j2[3][3], unsigned long long n)
+{
+   unsigned long long p1[3][3], p2[3][3];
+   for (int i=0; i<3; i++)
+      for (int j=0; j<3; j++) {
+         p1[i][j] = j1[i][j];
+         p2[i][j] = j2[i][j];
+      }
+   unsigned long long lm1 = m1, lm2 = m2;
+   for (; n != 0; n >>= 1) {
+      if (n & 1) {
+         mat_vec(p1, &g->s10, &g->s11, &g->s12, lm1);
+         mat_vec(p2, &g->s20, &g->s21, &g->s22, lm2);
+      }
+      mat_mul(p1, p1, p1, lm1);
+      mat_mul(p2, p2, p2, lm2);
+   }
+}
+
+void mrg_advance (mrg_t* g, unsigned long long stream)
+{
+   mrg_jump(g, A1p127, A2p127, stream);
+}
+
+void mrg_advance_substream (mrg_t* g, unsigned long long substream)
+{
+   mrg_jump(g, A1p76, A2p76, substream);
 }
@@ -1,3 +1,41 @@
-void mrg_seed();
-void mrg_seed_array();
-double MRG32k3a (void);
+/*
+ * State of one MRG32k3a generator. Each caller owns its own state,
+ * so several threads can draw from their own generators without locks.
+ */
+typedef struct {
+    double s10, s11, s12, // component 1
+           s20, s21, s22; // component 2
+} mrg_t;
+
+void mrg_seed(mrg_t* g,
+              unsigned int s10p, unsigned int s11p, unsigned int s12p,
+              unsigned int s20p, unsigned int s21p, unsigned int s22p);
+void mrg_seed_array(mrg_t* g, unsigned int* a);
+double MRG32k3a (mrg_t* g);
+
+/*
+ * Same draw as MRG32k3a, as an integer uniformly distributed
+ * on [0, 4294967086] (m1 - 1) instead of a double in (0, 1).
+ */
+unsigned int MRG32k3a_uint (mrg_t* g);
+
+/*
+ * Fills a[0..n-1] with the next n values of MRG32k3a_uint().
+ */
+void MRG32k3a_fill_uint (mrg_t* g, unsigned int* a, int n);
+
+/*
+ * Jumps g ahead by stream * 2^127 draws, to the start of stream number
+ * "stream" of the generator seeded in g. Streams of the same seed never
+ * overlap: each is 2^127 draws long, and the period is about 2^191.
+ * Uses the jump-ahead matrices of L'Ecuyer, Simard, Chen and Kelton,
+ * "An Object-Oriented Random-Number Package with Many Long Streams and
+ * Substreams", Operations Research 50(6), 2002.
+ */
+void mrg_advance (mrg_t* g, unsigned long long stream);
+
+/*
+ * Jumps g ahead by substream * 2^76 draws, to the start of substream number
+ * "substream" of its stream. A stream holds 2^51 substreams.
+ */
+void mrg_advance_substream (mrg_t* g, unsigned long long substream);
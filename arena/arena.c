@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include "arena.h"
+
+#define CACHE_LINE 64
+
+size_t arena_size(size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+int arena_init(arena* a, size_t size) {
+    a->size = arena_size(size);
+    a->used = 0;
+    a->base = aligned_alloc(CACHE_LINE, a->size > 0 ? a->size : CACHE_LINE);
+    return a->base == NULL ? -1 : 0;
+}
+
+void* arena_alloc(arena* a, size_t bytes) {
+    bytes = arena_size(bytes);
+    if (bytes > a->size - a->used) return NULL;
+
+    void* block = a->base + a->used;
+    a->used += bytes;
+    return block;
+}
+
+void arena_free(arena* a) {
+    free(a->base);
+    a->base = NULL;
+    a->size = a->used = 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * Arena of memory allocated once per worker and carved into buffers
+ * that are reused across simulations, so the simulation loop never
+ * calls malloc.
+ */
+#include <stddef.h>
+
+typedef struct {
+    char* base;  // start of the block
+    size_t size; // num of bytes in the block
+    size_t used; // num of bytes already handed out
+} arena;
+
+/*
+ * Allocates a block of "size" bytes.
+ * Returns 0 on success and -1 if the block can't be allocated.
+ */
+int arena_init(arena* a, size_t size);
+
+/*
+ * Hands out "bytes" bytes of the block, aligned to a cache line.
+ * Returns NULL if the block doesn't have enough bytes left.
+ */
+void* arena_alloc(arena* a, size_t bytes);
+
+/*
+ * Number of bytes to reserve in arena_init to hand out "bytes" bytes,
+ * accounting for the cache line alignment.
+ */
+size_t arena_size(size_t bytes);
+
+void arena_free(arena* a);
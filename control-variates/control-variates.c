@@ -0,0 +1,76 @@
+#include <string.h>
+#include "control-variates.h"
+
+// pivots below this fraction of the variance of their covariate are dropped
+#define DEGENERATE 1e-9
+
+void covariate_sums_init(covariate_sums* s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void covariate_sums_merge(covariate_sums* to, const covariate_sums* from) {
+    to->n += from->n;
+    to->y += from->y;
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        to->x[i] += from->x[i];
+        to->xy[i] += from->xy[i];
+        for (int j=0; j<NUM_COVARIATES; j++) {
+            to->xx[i][j] += from->xx[i][j];
+        }
+    }
+}
+
+void control_variate_estimate(const covariate_sums* s, double* estimate, double* variance) {
+    double n = s->n;
+    double meanY = s->y / n;
+    double meanX[NUM_COVARIATES];
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        meanX[i] = s->x[i] / n;
+    }
+
+    // sample covariances, a[i][j] of the covariates and b[i] with y
+    double a[NUM_COVARIATES][NUM_COVARIATES], b[NUM_COVARIATES];
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        for (int j=0; j<NUM_COVARIATES; j++) {
+            a[i][j] = (s->xx[i][j] - n * meanX[i] * meanX[j]) / (n - 1);
+        }
+        b[i] = (s->xy[i] - n * meanX[i] * meanY) / (n - 1);
+    }
+    double varY = (s->y - n * meanY * meanY) / (n - 1); // y^2 = y
+
+    // solve a beta = b by Gaussian elimination, a is symmetric positive
+    // semidefinite so no pivoting is needed, only dropping the covariates
+    // whose pivot vanishes
+    double beta[NUM_COVARIATES];
+    int used[NUM_COVARIATES], numUsed = 0;
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        used[i] = a[i][i] > 0 && a[i][i] > DEGENERATE * (s->xx[i][i] / n);
+        if (!used[i]) continue;
+        for (int j=i + 1; j<NUM_COVARIATES; j++) {
+            double f = a[j][i] / a[i][i];
+            for (int k=i; k<NUM_COVARIATES; k++) {
+                a[j][k] -= f * a[i][k];
+            }
+            b[j] -= f * b[i];
+        }
+        numUsed++;
+    }
+    double explained = 0;
+    for (int i=NUM_COVARIATES - 1; i>=0; i--) {
+        beta[i] = 0;
+        if (!used[i]) continue;
+        double r = b[i];
+        for (int j=i + 1; j<NUM_COVARIATES; j++) {
+            r -= a[i][j] * beta[j];
+        }
+        beta[i] = r / a[i][i];
+    }
+
+    *estimate = meanY;
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        *estimate -= beta[i] * meanX[i];
+        explained += beta[i] * ((s->xy[i] - n * meanX[i] * meanY) / (n - 1));
+    }
+    // the regression uses up one degree of freedom per covariate
+    *variance = (varY - explained) * (n - 1) / (n - 1 - numUsed);
+}
@@ -0,0 +1,53 @@
+/*
+ * Control variate estimator of a success probability.
+ *
+ * Besides its success y (0 or 1), each simulation reports a few covariates x
+ * whose expected values are known exactly. Regressing y on x gives the
+ * coefficients beta, and
+ *   mean(y) - beta . (mean(x) - E[x])
+ * estimates the same probability with the variance of the residual of the
+ * regression instead of the variance of y.
+ *
+ * The covariates are added centered, x - E[x], so the sums stay small and
+ * the sums of products don't cancel out.
+ */
+#define NUM_COVARIATES 3
+
+typedef struct {
+    long long n;                               // num of simulations added
+    double y;                                  // sum of y
+    double x[NUM_COVARIATES];                  // sums of x - E[x]
+    double xx[NUM_COVARIATES][NUM_COVARIATES]; // sums of (x - E[x]) (x - E[x])^T
+    double xy[NUM_COVARIATES];                 // sums of (x - E[x]) y
+} covariate_sums;
+
+void covariate_sums_init(covariate_sums* s);
+
+/*
+ * Adds the sums of "from" to "to", eg. the sums of every thread or process.
+ */
+void covariate_sums_merge(covariate_sums* to, const covariate_sums* from);
+
+/*
+ * Sets *estimate to the control variate estimate of the success probability
+ * and *variance to the variance of the residual of one simulation, so the
+ * estimate has variance *variance / n. Covariates that barely vary, or that
+ * are linear combinations of the others, are left out of the regression.
+ * Needs n > NUM_COVARIATES + 1.
+ */
+void control_variate_estimate(const covariate_sums* s, double* estimate, double* variance);
+
+/*
+ * Adds one simulation with success y and centered covariates x.
+ */
+static inline void covariate_sums_add(covariate_sums* s, const double x[NUM_COVARIATES], int y) {
+    s->n++;
+    s->y += y;
+    for (int i=0; i<NUM_COVARIATES; i++) {
+        s->x[i] += x[i];
+        s->xy[i] += x[i] * y;
+        for (int j=0; j<NUM_COVARIATES; j++) {
+            s->xx[i][j] += x[i] * x[j];
+        }
+    }
+}
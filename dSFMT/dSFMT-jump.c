@@ -0,0 +1,90 @@
+/**
+ * @file dSFMT-jump.c
+ *
+ * @brief jump function of dSFMT, see dSFMT-jump.h
+ *
+ * The transition of dSFMT is linear on the mantissas of the state and on
+ * the lung, and leaves the exponents of the state untouched, so the jump
+ * adds up the states x^i for every coefficient of the jump polynomial,
+ * then restores the exponents.
+ *
+ * The new BSD License is applied to this software, see LICENSE.txt
+ */
+#include <string.h>
+#include <assert.h>
+#include "dSFMT-params.h"
+#include "dSFMT-common.h"
+#include "dSFMT-jump.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if DSFMT_MEXP == 521
+/* x^(2^100) modulo the minimal polynomial of degree 545, found with the
+ * Berlekamp-Massey algorithm on the output of dSFMT-521 */
+const char * const dsfmt_jump_2_100 =
+    "26e8fdee9a12eecd9dfe9a23abd41b805e69884e77c324f6127948518fbc4b01"
+    "c73367d315baa26285ee777059cee6e3c1c012ab350982f23c246ad1a1abe028"
+    "c24a4e0a1";
+#else
+  #error "dsfmt_jump_2_100 is only computed for DSFMT_MEXP 521"
+#endif
+
+/**
+ * Generates one 128-bit word in place, status[idx] is the oldest word
+ * of the state and becomes the newest.
+ */
+inline static void next_state(dsfmt_t *dsfmt, int *idx) {
+    w128_t *status = dsfmt->status;
+    do_recursion(&status[*idx], &status[*idx],
+                 &status[(*idx + DSFMT_POS1) % DSFMT_N], &status[DSFMT_N]);
+    *idx = (*idx + 1) % DSFMT_N;
+}
+
+/**
+ * dest += src, both states read from their oldest word.
+ */
+inline static void add(dsfmt_t *dest, const dsfmt_t *src, int src_idx) {
+    for (int i = 0; i < DSFMT_N; i++) {
+        int p = (i + src_idx) % DSFMT_N;
+        dest->status[i].u[0] ^= src->status[p].u[0];
+        dest->status[i].u[1] ^= src->status[p].u[1];
+    }
+    dest->status[DSFMT_N].u[0] ^= src->status[DSFMT_N].u[0];
+    dest->status[DSFMT_N].u[1] ^= src->status[DSFMT_N].u[1];
+}
+
+void dsfmt_jump(dsfmt_t *dsfmt, const char *jump_string) {
+    dsfmt_t work;
+    int idx = 0; /* at a block boundary status[0] is the oldest word */
+    assert(dsfmt->idx == DSFMT_N64);
+    memset(&work, 0, sizeof(work));
+    for (int i = 0; jump_string[i] != '\0'; i++) {
+        int c = jump_string[i];
+        int bits = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+        for (int j = 0; j < 4; j++) {
+            if ((bits & 1) != 0) {
+                add(&work, dsfmt, idx);
+            }
+            next_state(dsfmt, &idx);
+            bits >>= 1;
+        }
+    }
+    for (int i = 0; i < DSFMT_N; i++) {
+        work.status[i].u[0] = (work.status[i].u[0] & DSFMT_LOW_MASK) | DSFMT_HIGH_CONST;
+        work.status[i].u[1] = (work.status[i].u[1] & DSFMT_LOW_MASK) | DSFMT_HIGH_CONST;
+    }
+    memcpy(dsfmt->status, work.status, sizeof(work.status));
+    dsfmt->idx = DSFMT_N64;
+}
+
+void dsfmt_jump_stream(dsfmt_t *dsfmt, unsigned long long stream) {
+    for (unsigned long long i = 0; i < stream; i++) {
+        dsfmt_jump(dsfmt, dsfmt_jump_2_100);
+    }
+}
+
+#if defined(__cplusplus)
+}
+#endif
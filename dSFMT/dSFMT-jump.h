@@ -0,0 +1,52 @@
+#pragma once
+#ifndef DSFMT_JUMP_H
+#define DSFMT_JUMP_H
+/**
+ * @file dSFMT-jump.h
+ *
+ * @brief jump function of dSFMT, which moves the internal state ahead
+ * without generating the numbers in between.
+ *
+ * A jump of J steps (one step generates one 128-bit word, two doubles)
+ * is given by the polynomial x^J reduced modulo the minimal polynomial
+ * of the state transition. The polynomial is written as a string of
+ * hexadecimal digits, lowest degree first, each digit holding four
+ * coefficients with the lowest one in its least significant bit.
+ *
+ * The new BSD License is applied to this software, see LICENSE.txt
+ */
+#include "dSFMT.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * jump polynomial of 2^100 steps (2^101 doubles) for DSFMT_MEXP 521,
+ * far more numbers than any stream will ever draw.
+ */
+extern const char * const dsfmt_jump_2_100;
+
+/**
+ * Moves the state of dsfmt ahead by the number of steps of jump_string.
+ * The state must be at a block boundary, like right after
+ * dsfmt_init_gen_rand or dsfmt_fill_array_*, which is where the fill
+ * functions require it to be anyway.
+ * @param dsfmt dSFMT internal state
+ * @param jump_string jump polynomial, see above
+ */
+void dsfmt_jump(dsfmt_t *dsfmt, const char *jump_string);
+
+/**
+ * Moves the state of dsfmt to the start of stream number "stream",
+ * stream * 2^100 steps ahead. Streams of the same seed never overlap.
+ * @param dsfmt dSFMT internal state, at a block boundary
+ * @param stream number of the stream
+ */
+void dsfmt_jump_stream(dsfmt_t *dsfmt, unsigned long long stream);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* DSFMT_JUMP_H */
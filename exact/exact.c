@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <math.h>
+#include "exact.h"
+
+#define DIRECT_TERMS 1000000
+
+// H(m) - ln(m) - gamma, accurate to about 1/m^8
+static long double harmonic_remainder(long long m) {
+    long double inv = 1.0L / m;
+    long double inv2 = inv * inv;
+    return inv/2 - inv2*(1.0L/12 - inv2*(1.0L/120 - inv2/252));
+}
+
+long double harmonic_difference(long long n, long long k) {
+    if (n <= k) return 0;
+
+    // sum the terms 1/(k+1) .. 1/m directly, and the terms past m asymptotically
+    long long m = k;
+    if (k < DIRECT_TERMS) m = n < DIRECT_TERMS ? n : DIRECT_TERMS;
+
+    long double sum = 0, compensation = 0;
+    for (long long j=m; j>k; j--) {
+        long double y = 1.0L / j - compensation;
+        long double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+
+    if (n > m) {
+        sum += log1pl((long double)(n - m) / m)
+               + harmonic_remainder(n) - harmonic_remainder(m);
+    }
+    return sum;
+}
+
+// Returns q(n) of the recurrence below, and stores q(0) .. q(n) in table
+// unless it is NULL. Returns -1 if the window can't be allocated.
+static long double recurrence(long long n, long long k, double* table) {
+    // q(m) is the probability that a random permutation of m elements has no
+    // cycle longer than k. The cycle holding the first element has a length l
+    // uniform on [1, m], so q(m) = (q(m-1) + ... + q(m-min(m,k))) / m.
+    // window holds the last k values of q, and windowSum their sum.
+    long double* window = malloc(sizeof(long double) * k);
+    if (window == NULL) return -1;
+
+    long double q = 1; // q(0)
+    long double windowSum = 0;
+    for (long long i=0; i<k; i++) window[i] = 0;
+    if (table != NULL) table[0] = q;
+
+    for (long long m=1; m<=n; m++) {
+        // slide q(m-1) into the window in place of q(m-1-k)
+        long long slot = (m - 1) % k;
+        windowSum += q - window[slot];
+        window[slot] = q;
+
+        // q shrinks geometrically when k is small, and subtracting the old
+        // values loses precision, so recompute the sum every k steps
+        if (slot == k - 1) {
+            windowSum = 0;
+            for (long long i=0; i<k; i++) windowSum += window[i];
+        }
+        q = windowSum / m;
+        if (table != NULL) table[m] = q;
+    }
+    free(window);
+    return q;
+}
+
+long double exact_probability(long long n, long long k) {
+    if (k >= n) return 1;
+    if (2*k >= n) return 1 - harmonic_difference(n, k);
+    if (k <= 0) return 0;
+    return recurrence(n, k, NULL);
+}
+
+int success_table(long long n, long long k, double* q) {
+    if (k <= 0) {
+        for (long long m=0; m<=n; m++) q[m] = m == 0;
+        return 0;
+    }
+    return recurrence(n, k, q) < 0 ? -1 : 0;
+}
+
+long double log_exact_probability(long long n, long long k) {
+    if (k >= n) return 0;
+    if (k <= 0) return -INFINITY;
+
+    // q(m) of recurrence above, with the window and q kept near 1,
+    // logScale holds the log of the factor they were divided by
+    long double* window = malloc(sizeof(long double) * k);
+    if (window == NULL) return NAN;
+
+    long double q = 1, windowSum = 0, logScale = 0;
+    for (long long i=0; i<k; i++) window[i] = 0;
+
+    for (long long m=1; m<=n; m++) {
+        long long slot = (m - 1) % k;
+        windowSum += q - window[slot];
+        window[slot] = q;
+        if (slot == k - 1) {
+            windowSum = 0;
+            for (long long i=0; i<k; i++) windowSum += window[i];
+        }
+        q = windowSum / m;
+
+        if (q < 1e-100L) {
+            for (long long i=0; i<k; i++) window[i] /= q;
+            windowSum /= q;
+            logScale += logl(q);
+            q = 1;
+        }
+    }
+    free(window);
+    return logl(q) + logScale;
+}
@@ -0,0 +1,38 @@
+/*
+ * Exact probability that all prisoners find their tag number,
+ * for any number of prisoners n and any number of boxes k each may open.
+ *
+ * All prisoners succeed exactly when the random permutation of the boxes has
+ * no cycle longer than k.
+ * When 2k >= n at most one cycle can be longer than k, and the probability is
+ * 1 - (H(n) - H(k)), where H is the harmonic number.
+ * Otherwise it is computed with the recurrence over the length of the cycle
+ * that contains the first box, which needs k long doubles of memory.
+ *
+ * Returns a negative value if the memory for the recurrence can't be allocated.
+ */
+long double exact_probability(long long n, long long k);
+
+/*
+ * Returns H(n) - H(k) = 1/(k+1) + 1/(k+2) + ... + 1/n, for 0 <= k <= n.
+ * Up to a million terms are summed directly with compensated (Kahan)
+ * summation, smallest terms first. The rest of the sum, for n in the
+ * billions, comes from the asymptotic expansion of the harmonic numbers.
+ */
+long double harmonic_difference(long long n, long long k);
+
+/*
+ * Sets q[m] to the probability that a random permutation of m elements has no
+ * cycle longer than k, for every m from 0 to n, with the recurrence of
+ * exact_probability. q holds n + 1 elements.
+ * Returns 0 on success and -1 if the memory for the recurrence can't be allocated.
+ */
+int success_table(long long n, long long k, double* q);
+
+/*
+ * Returns the natural log of exact_probability(n, k), with the same recurrence
+ * rescaled to stay in range, so it doesn't underflow for the tiny probabilities
+ * of large n and small k.
+ * Returns NAN if the memory for the recurrence can't be allocated.
+ */
+long double log_exact_probability(long long n, long long k);
@@ -0,0 +1,24 @@
+#include <string.h>
+#include "paired.h"
+
+void paired_sums_init(paired_sums* s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void paired_sums_merge(paired_sums* to, const paired_sums* from) {
+    to->n += from->n;
+    for (int i=0; i<MAX_EVALUATORS; i++) {
+        to->y[i] += from->y[i];
+        to->both[i] += from->both[i];
+    }
+}
+
+void paired_difference(const paired_sums* s, int i, double* difference, double* variance, double* unpaired) {
+    double n = s->n;
+    double p0 = s->y[0] / n, pi = s->y[i] / n;
+    *difference = pi - p0;
+    // (y[i] - y[0])^2 is 1 when exactly one of them succeeds
+    double squares = s->y[i] + s->y[0] - 2.0 * s->both[i];
+    *variance = (squares - n * *difference * *difference) / (n - 1);
+    *unpaired = (s->y[i] * (1 - pi) + s->y[0] * (1 - p0)) / (n - 1);
+}
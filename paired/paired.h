@@ -0,0 +1,45 @@
+/*
+ * Paired comparison of several evaluators of the same simulations.
+ *
+ * Every simulation is judged by each evaluator, eg. different strategies,
+ * trial limits or implementations, with success y[i] (0 or 1) for evaluator i.
+ * The difference y[i] - y[0] of two evaluators of the same simulation
+ * (common random numbers) estimates the difference of their success
+ * probabilities with the variance
+ *   var(y[i]) + var(y[0]) - 2 cov(y[i], y[0])
+ * which is far below the variance var(y[i]) + var(y[0]) of the difference of
+ * two separate runs when the evaluators mostly agree.
+ */
+#define MAX_EVALUATORS 8
+
+typedef struct {
+    long long n;                    // num of simulations added
+    long long y[MAX_EVALUATORS];    // num of successes of each evaluator
+    long long both[MAX_EVALUATORS]; // num of successes of each evaluator and the first together
+} paired_sums;
+
+void paired_sums_init(paired_sums* s);
+
+/*
+ * Adds the sums of "from" to "to", eg. the sums of every thread or process.
+ */
+void paired_sums_merge(paired_sums* to, const paired_sums* from);
+
+/*
+ * Sets *difference to the estimate of the success probability of evaluator i
+ * minus the one of the first, *variance to the variance of one paired
+ * difference, and *unpaired to the variance of the difference of one
+ * simulation of each evaluator in separate runs. Needs n > 1.
+ */
+void paired_difference(const paired_sums* s, int i, double* difference, double* variance, double* unpaired);
+
+/*
+ * Adds one simulation with success y[i] for each of the numEvaluators evaluators.
+ */
+static inline void paired_sums_add(paired_sums* s, const int* y, int numEvaluators) {
+    s->n++;
+    for (int i=0; i<numEvaluators; i++) {
+        s->y[i] += y[i];
+        s->both[i] += y[i] & y[0];
+    }
+}
@@ -0,0 +1,46 @@
+#include "philox.h"
+
+#define M0 0xD2511F53U
+#define M1 0xCD9E8D57U
+#define W0 0x9E3779B9U // golden ratio
+#define W1 0xBB67AE85U // sqrt(3) - 1
+
+void philox4x32(const unsigned int counter[4], const unsigned int key[2], unsigned int out[4]) {
+    unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    unsigned int k0 = key[0], k1 = key[1];
+
+    for (int round=0; round<10; round++) {
+        unsigned long long p0 = (unsigned long long)M0 * c0;
+        unsigned long long p1 = (unsigned long long)M1 * c2;
+        c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (unsigned int)p1;
+        c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (unsigned int)p0;
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+void philox_seed(philox_t* p, unsigned long long seed) {
+    p->key[0] = (unsigned int)seed;
+    p->key[1] = (unsigned int)(seed >> 32);
+    philox_set_stream(p, 0);
+}
+
+void philox_set_stream(philox_t* p, unsigned long long stream) {
+    p->stream = stream;
+    p->block = 0;
+}
+
+void philox_fill(philox_t* p, unsigned int* a, int n) {
+    unsigned int counter[4];
+    counter[2] = (unsigned int)p->stream;
+    counter[3] = (unsigned int)(p->stream >> 32);
+
+    for (int i=0; i<n; i += 4, p->block++) {
+        counter[0] = (unsigned int)p->block;
+        counter[1] = (unsigned int)(p->block >> 32);
+        philox4x32(counter, p->key, a + i);
+    }
+}
@@ -0,0 +1,34 @@
+/*
+ * Philox4x32-10 counter-based PRNG.
+ * Source: J. K. Salmon, M. A. Moraes, R. O. Dror, D. E. Shaw,
+ *         "Parallel Random Numbers: As Easy as 1, 2, 3",
+ *         Proceedings of SC11, 2011.
+ *
+ * Each 128-bit counter is encrypted with a 64-bit key into 4 random words,
+ * so any word of any stream can be computed directly, without generating
+ * the words before it. The counter holds the stream number in its high
+ * 64 bits and the block number within the stream in its low 64 bits.
+ */
+typedef struct {
+    unsigned int key[2];       // run seed
+    unsigned long long stream; // stream number, eg. the index of a simulation
+    unsigned long long block;  // next block of 4 words within the stream
+} philox_t;
+
+/*
+ * Encrypts counter[0..3] with key[0..1] into out[0..3].
+ */
+void philox4x32(const unsigned int counter[4], const unsigned int key[2], unsigned int out[4]);
+
+void philox_seed(philox_t* p, unsigned long long seed);
+
+/*
+ * Moves to the start of stream number "stream".
+ */
+void philox_set_stream(philox_t* p, unsigned long long stream);
+
+/*
+ * Fills a[0..n-1] with the next n words of the current stream,
+ * n must be a multiple of 4.
+ */
+void philox_fill(philox_t* p, unsigned int* a, int n);
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "rng.h"
+
+// splitmix64, expands the run seed into the seeds of the backends
+static unsigned long long nextSeed(unsigned long long* state) {
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// output number "stream" of splitmix64 started at seed, distinct for every stream
+static unsigned long long streamSeed(unsigned long long seed, int stream) {
+    unsigned long long state = seed + 0x9E3779B97F4A7C15ULL * (unsigned long long)stream;
+    return nextSeed(&state);
+}
+
+// default c PRNG
+static void random_seed(struct rng* r, unsigned long long seed, int stream) {
+#ifdef __GLIBC__
+    memset(&r->state.random.data, 0, sizeof(r->state.random.data));
+    initstate_r(streamSeed(seed, stream), r->state.random.state,
+                sizeof(r->state.random.state), &r->state.random.data);
+#else
+    srandom(streamSeed(seed, stream));
+#endif
+}
+
+static void random_fill(struct rng* r, unsigned int* words, int n) {
+    for (int i=0; i<n; i++) {
+#ifdef __GLIBC__
+        int32_t word;
+        random_r(&r->state.random.data, &word);
+        words[i] = word;
+#else
+        words[i] = random();
+#endif
+    }
+}
+
+// MRG32k3a PRNG, every stream is 2^127 numbers long
+static void mrg_backend_seed(struct rng* r, unsigned long long seed, int stream) {
+    unsigned int seeds[6];
+    for (int i=0; i<6; i++) {
+        seeds[i] = nextSeed(&seed) >> 32;
+    }
+    mrg_seed_array(&r->state.mrg, seeds);
+    mrg_advance(&r->state.mrg, stream);
+}
+
+static void mrg_fill(struct rng* r, unsigned int* words, int n) {
+    MRG32k3a_fill_uint(&r->state.mrg, words, n);
+}
+
+// dSFMT (successor of mersenne twister), every stream is 2^100 steps long
+static void dsfmt_seed(struct rng* r, unsigned long long seed, int stream) {
+    uint32_t seeds[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+    dsfmt_init_by_array(&r->state.dsfmt.dsfmt, seeds, 2);
+    dsfmt_jump_stream(&r->state.dsfmt.dsfmt, stream);
+}
+
+static void dsfmt_fill(struct rng* r, unsigned int* restrict words, int n) {
+    // the doubles in [1, 2) carry 52 random bits in their mantissa,
+    // keep the low 32 like dsfmt_genrand_uint32 does. gcc only vectorizes
+    // the copy with a constant trip count, so it goes 16 words at a time,
+    // the block size of this backend is a multiple of 16.
+    double* restrict block = r->state.dsfmt.block;
+    dsfmt_fill_array_close1_open2(&r->state.dsfmt.dsfmt, block, n);
+    for (int i=0; i<n; i+=16) {
+        for (int j=i; j<i+16; j++) {
+            unsigned long long bits;
+            memcpy(&bits, &block[j], sizeof(bits));
+            words[j] = (unsigned int)bits;
+        }
+    }
+}
+
+// Marsa Lfib4 PRNG
+static void lfib4_seed(struct rng* r, unsigned long long seed, int stream) {
+    unsigned long long state = streamSeed(seed, stream);
+    unsigned int table[1 << 8];
+    for (int i=0; i<(1 << 8); i++) {
+        table[i] = nextSeed(&state) >> 32;
+    }
+    Lfib4_seed(&r->state.lfib4, (unsigned char)state, table);
+}
+
+static void lfib4_fill(struct rng* r, unsigned int* words, int n) {
+    Lfib4_fill(&r->state.lfib4, words, n);
+}
+
+// Philox counter-based PRNG, every simulation has its own stream of the run seed
+static void philox_backend_seed(struct rng* r, unsigned long long seed, int stream) {
+    (void)stream; // every simulation gets its own stream instead, see philox_seed_simulation
+    philox_seed(&r->state.philox, seed);
+}
+
+static void philox_seed_simulation(struct rng* r, long long i) {
+    philox_set_stream(&r->state.philox, i);
+}
+
+static void philox_backend_fill(struct rng* r, unsigned int* words, int n) {
+    philox_fill(&r->state.philox, words, n);
+}
+
+const struct rng_backend rng_backends[] = {
+    { "random", RNG_RANGE_31, RANDOM_BUFFER_SIZE, random_seed, NULL, random_fill },
+    { "mrg", RNG_RANGE_MRG, RANDOM_BUFFER_SIZE, mrg_backend_seed, NULL, mrg_fill },
+    { "dsfmt", RNG_RANGE_32, RANDOM_BUFFER_SIZE, dsfmt_seed, NULL, dsfmt_fill },
+    { "lfib4", RNG_RANGE_32, RANDOM_BUFFER_SIZE, lfib4_seed, NULL, lfib4_fill },
+    // Philox restarts the buffer at every simulation, keep its blocks small
+    { "philox", RNG_RANGE_32, 64, philox_backend_seed, philox_seed_simulation, philox_backend_fill },
+};
+const int rng_num_backends = sizeof(rng_backends) / sizeof(rng_backends[0]);
+
+const struct rng_backend* rng_find_backend(const char* name) {
+    for (int i=0; i<rng_num_backends; i++) {
+        if (strcmp(rng_backends[i].name, name) == 0) {
+            return &rng_backends[i];
+        }
+    }
+    return NULL;
+}
+
+void rng_init(struct rng* r, const struct rng_backend* b, unsigned long long seed, int stream) {
+    r->backend = b;
+    b->seed(r, seed, stream);
+    r->index = RANDOM_BUFFER_SIZE;
+}
+
+size_t rng_refill(struct rng* r) {
+    int n = r->backend->blockSize;
+    r->backend->fill(r, r->buffer + RANDOM_BUFFER_SIZE - n, n);
+    return RANDOM_BUFFER_SIZE - n;
+}
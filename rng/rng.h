@@ -0,0 +1,98 @@
+/*
+ * PRNG backends that the simulation can draw from, selected at startup.
+ *
+ * Every backend fills a block of words at once, and the simulation hands
+ * them out one by one from the buffer of a struct rng, so the backend is
+ * only called through its function table once per block, never per word.
+ */
+#include <stdlib.h>
+#include "../MRG32k3a/MRG32k3a.h"
+#include "../dSFMT/dSFMT.h"
+#include "../dSFMT/dSFMT-jump.h"
+#include "../Lfib4/Lfib4.h"
+#include "../philox/philox.h"
+
+#define RANDOM_BUFFER_SIZE 1024 // words in the buffer of a struct rng, the most a backend fills at once
+
+// ranges of the words of the backends, the words are uniformly distributed
+// on [0, range). These are the only ranges the simulation kernels are
+// compiled for, see WITH_WORD_RANGE in 100prisoners.c.
+#define RNG_RANGE_31 (1ULL << 31)   // random() returns 31 bits
+#define RNG_RANGE_32 (1ULL << 32)
+#define RNG_RANGE_MRG 4294967087ULL // m1 of MRG32k3a
+
+struct rng;
+
+/*
+ * Entry points of one PRNG.
+ *
+ * seed moves r to stream number "stream" of the run seed "seed". Backends
+ * with a jump function jump there, so streams of the same seed never
+ * overlap; the others are seeded with a hash of the seed and the stream.
+ *
+ * seedSimulation, if not NULL, moves r to the stream of simulation number i,
+ * so every simulation draws the same numbers whichever worker performs it.
+ *
+ * fill writes the next n words of r to words, n is a multiple of 4.
+ */
+struct rng_backend {
+    const char* name;
+    unsigned long long wordRange; // RNG_RANGE_31, RNG_RANGE_32 or RNG_RANGE_MRG
+    int blockSize;                // words generated per fill, at most RANDOM_BUFFER_SIZE
+    void (*seed)(struct rng* r, unsigned long long seed, int stream);
+    void (*seedSimulation)(struct rng* r, long long i);
+    void (*fill)(struct rng* r, unsigned int* words, int n);
+};
+
+/*
+ * State of one PRNG along with the buffer of words it generates in blocks.
+ * Each thread or process owns one, so no two of them ever share the state
+ * of a generator.
+ *
+ * With glibc, random() is replaced by random_r on a state of its own.
+ * Elsewhere random() keeps its single hidden state for the whole process.
+ */
+struct rng {
+    const struct rng_backend* backend;
+    union {
+#ifdef __GLIBC__
+        struct {
+            struct random_data data;
+            char state[128];
+        } random;
+#endif
+        mrg_t mrg;
+        struct {
+            dsfmt_t dsfmt;
+            double block[RANDOM_BUFFER_SIZE] __attribute__((aligned(16))); // output of the bulk fill
+        } dsfmt;
+        lfib4_t lfib4;
+        philox_t philox;
+    } state;
+    unsigned int buffer[RANDOM_BUFFER_SIZE]; // words handed out one by one
+    size_t index; // next unused word of buffer, the buffer is empty at RANDOM_BUFFER_SIZE
+};
+
+/*
+ * Backends by name: "random", "mrg", "dsfmt", "lfib4" and "philox",
+ * in the order of the old PRNG compile flag (0 to 4).
+ */
+extern const struct rng_backend rng_backends[];
+extern const int rng_num_backends;
+
+/*
+ * Returns the backend named "name", or NULL if there is none.
+ */
+const struct rng_backend* rng_find_backend(const char* name);
+
+/*
+ * Makes r draw from backend b, at stream number "stream" of the run seed
+ * "seed", with an empty buffer.
+ */
+void rng_init(struct rng* r, const struct rng_backend* b, unsigned long long seed, int stream);
+
+/*
+ * Refills the end of the buffer of r with one block of its backend,
+ * and returns the index of the first new word.
+ */
+size_t rng_refill(struct rng* r);
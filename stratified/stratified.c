@@ -0,0 +1,51 @@
+#include <math.h>
+#include <string.h>
+#include "stratified.h"
+
+void strata_sums_init(strata_sums* s) {
+    memset(s, 0, sizeof(*s));
+}
+
+void strata_sums_merge(strata_sums* to, const strata_sums* from) {
+    for (int h=0; h<MAX_STRATA; h++) {
+        to->n[h] += from->n[h];
+        to->y[h] += from->y[h];
+    }
+}
+
+void strata_allocate(const strata_sums* pilot, const double* w, int numStrata, long long n, long long* count) {
+    double share[MAX_STRATA], total = 0;
+    for (int h=0; h<numStrata; h++) {
+        share[h] = w[h];
+        if (pilot != NULL) {
+            // (y + 1) / (n + 2) instead of y / n, so a stratum whose pilot
+            // happened to always succeed or always fail keeps a share
+            double p = (pilot->y[h] + 1.0) / (pilot->n[h] + 2.0);
+            share[h] *= sqrt(p * (1 - p));
+        }
+        total += share[h];
+    }
+
+    // 2 simulations each, then the rest rounded so the counts add up to n
+    long long rest = n - 2LL * numStrata;
+    double cumulative = 0;
+    long long allocated = 0;
+    for (int h=0; h<numStrata; h++) {
+        cumulative += share[h];
+        long long upTo = h == numStrata - 1 ? rest : llround(rest * (cumulative / total));
+        count[h] = 2 + upTo - allocated;
+        allocated = upTo;
+    }
+}
+
+void stratified_estimate(const strata_sums* s, const double* w, int numStrata, double* estimate, double* variance) {
+    *estimate = 0;
+    *variance = 0;
+    for (int h=0; h<numStrata; h++) {
+        double n = s->n[h];
+        double mean = s->y[h] / n;
+        double var = (s->y[h] * (1 - mean)) / (n - 1); // y^2 = y
+        *estimate += w[h] * mean;
+        *variance += w[h] * w[h] * var / n;
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Stratified estimator of a success probability.
+ *
+ * The simulations are split into strata of known probabilities w[h], each
+ * sampling only the outcomes of its own stratum, so
+ *   sum over h of w[h] * mean(y of stratum h)
+ * estimates the probability without the variance between the strata.
+ * The simulations are allocated to the strata in proportion to w[h] s[h],
+ * s[h] being the standard deviation of y in stratum h (Neyman allocation),
+ * which gives the smallest variance for the number of simulations. s[h] is
+ * unknown until simulated, so it comes from a pilot run allocated in
+ * proportion to w[h] alone.
+ */
+#define MAX_STRATA 64
+
+typedef struct {
+    long long n[MAX_STRATA]; // num of simulations of each stratum
+    long long y[MAX_STRATA]; // num of successes of each stratum
+} strata_sums;
+
+void strata_sums_init(strata_sums* s);
+
+/*
+ * Adds the sums of "from" to "to", eg. the sums of every thread or process.
+ */
+void strata_sums_merge(strata_sums* to, const strata_sums* from);
+
+/*
+ * Sets count[h] to the number of the "n" simulations to allocate to each of
+ * the numStrata strata of probabilities w: in proportion to w[h] without a
+ * pilot, or to w[h] s[h] with the standard deviations s[h] of the sums of a
+ * pilot run. Every stratum gets at least 2 simulations, so its variance can
+ * be estimated. Needs n >= 2 numStrata.
+ */
+void strata_allocate(const strata_sums* pilot, const double* w, int numStrata, long long n, long long* count);
+
+/*
+ * Sets *estimate to the stratified estimate of the success probability from
+ * the sums s of numStrata strata of probabilities w, and *variance to the
+ * variance of the estimate itself, sum over h of w[h]^2 s[h]^2 / n[h].
+ * Needs at least 2 simulations in every stratum.
+ */
+void stratified_estimate(const strata_sums* s, const double* w, int numStrata, double* estimate, double* variance);
+
+/*
+ * Adds one simulation of stratum h with success y.
+ */
+static inline void strata_sums_add(strata_sums* s, int h, int y) {
+    s->n[h]++;
+    s->y[h] += y;
+}
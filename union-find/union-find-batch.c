@@ -0,0 +1,142 @@
+#include "union-find-batch.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+void set_union_batch_init(set_union_batch* s, int n) {
+    for (int i=0; i<n; i++) {
+        for (int l=0; l<BATCH_LANES; l++) {
+            s->p[i*BATCH_LANES + l] = i;
+            s->size[i*BATCH_LANES + l] = 1;
+        }
+    }
+    s->n = n;
+}
+
+#if defined(__AVX512F__)
+
+// union by size keeps the trees shallow, so find skips path compression
+// and never needs to write back to p
+static inline __m512i find_batch(const int* p, __m512i x, __m512i lane) {
+    for (;;) {
+        __m512i idx = _mm512_add_epi32(_mm512_slli_epi32(x, 4), lane);
+        __m512i parent = _mm512_i32gather_epi32(idx, p, 4);
+        if (!_mm512_cmpneq_epi32_mask(parent, x)) return x;
+        x = parent;
+    }
+}
+
+unsigned int union_set_batch(set_union_batch* s, int s1, const int* s2, int limit) {
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                           8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i r1 = find_batch(s->p, _mm512_set1_epi32(s1), lane);
+    __m512i r2 = find_batch(s->p, _mm512_loadu_si512(s2), lane);
+
+    __m512i i1 = _mm512_add_epi32(_mm512_slli_epi32(r1, 4), lane);
+    __m512i i2 = _mm512_add_epi32(_mm512_slli_epi32(r2, 4), lane);
+    __m512i size1 = _mm512_i32gather_epi32(i1, s->size, 4);
+    __m512i size2 = _mm512_i32gather_epi32(i2, s->size, 4);
+
+    __mmask16 differ = _mm512_cmpneq_epi32_mask(r1, r2);
+    __m512i merged = _mm512_mask_add_epi32(size1, differ, size1, size2);
+
+    // attach the smaller tree under the larger one
+    __mmask16 first = _mm512_cmpge_epi32_mask(size1, size2);
+    __m512i root = _mm512_mask_blend_epi32(first, i2, i1);
+    __m512i child = _mm512_mask_blend_epi32(first, i1, i2);
+    __m512i rootElem = _mm512_mask_blend_epi32(first, r2, r1);
+
+    // lanes never share an address, so the scatters can't conflict
+    _mm512_mask_i32scatter_epi32(s->p, differ, child, rootElem, 4);
+    _mm512_mask_i32scatter_epi32(s->size, differ, root, merged, 4);
+
+    return _mm512_cmpgt_epi32_mask(merged, _mm512_set1_epi32(limit));
+}
+
+#elif defined(__AVX2__)
+
+static inline unsigned int mask_batch(__m256i m) {
+    return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+// union by size keeps the trees shallow, so find skips path compression
+// and never needs to write back to p
+static inline __m256i find_batch(const int* p, __m256i x, __m256i lane) {
+    for (;;) {
+        __m256i idx = _mm256_add_epi32(_mm256_slli_epi32(x, 3), lane);
+        __m256i parent = _mm256_i32gather_epi32(p, idx, 4);
+        if (mask_batch(_mm256_cmpeq_epi32(parent, x)) == 0xFF) return x;
+        x = parent;
+    }
+}
+
+unsigned int union_set_batch(set_union_batch* s, int s1, const int* s2, int limit) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i r1 = find_batch(s->p, _mm256_set1_epi32(s1), lane);
+    __m256i r2 = find_batch(s->p, _mm256_loadu_si256((const __m256i*)s2), lane);
+
+    __m256i i1 = _mm256_add_epi32(_mm256_slli_epi32(r1, 3), lane);
+    __m256i i2 = _mm256_add_epi32(_mm256_slli_epi32(r2, 3), lane);
+    __m256i size1 = _mm256_i32gather_epi32(s->size, i1, 4);
+    __m256i size2 = _mm256_i32gather_epi32(s->size, i2, 4);
+
+    __m256i same = _mm256_cmpeq_epi32(r1, r2);
+    __m256i merged = _mm256_add_epi32(size1, _mm256_andnot_si256(same, size2));
+
+    // attach the smaller tree under the larger one
+    __m256i second = _mm256_cmpgt_epi32(size2, size1);
+    __m256i root = _mm256_blendv_epi8(i1, i2, second);
+    __m256i child = _mm256_blendv_epi8(i2, i1, second);
+    __m256i rootElem = _mm256_blendv_epi8(r1, r2, second);
+
+    // AVX2 has no scatter, store the lanes and write them back one by one
+    int rootOut[8], childOut[8], rootElemOut[8], mergedOut[8];
+    _mm256_storeu_si256((__m256i*)rootOut, root);
+    _mm256_storeu_si256((__m256i*)childOut, child);
+    _mm256_storeu_si256((__m256i*)rootElemOut, rootElem);
+    _mm256_storeu_si256((__m256i*)mergedOut, merged);
+    unsigned int differ = ~mask_batch(same) & 0xFF;
+    for (int l=0; l<8; l++) {
+        if (differ & (1u << l)) {
+            s->p[childOut[l]] = rootElemOut[l];
+            s->size[rootOut[l]] = mergedOut[l];
+        }
+    }
+
+    return mask_batch(_mm256_cmpgt_epi32(merged, _mm256_set1_epi32(limit)));
+}
+
+#else
+
+static int find_lane(const set_union_batch* s, int x, int l) {
+    while (s->p[x*BATCH_LANES + l] != x) x = s->p[x*BATCH_LANES + l];
+    return x;
+}
+
+unsigned int union_set_batch(set_union_batch* s, int s1, const int* s2, int limit) {
+    unsigned int exceeded = 0;
+    for (int l=0; l<BATCH_LANES; l++) {
+        int r1 = find_lane(s, s1, l);
+        int r2 = find_lane(s, s2[l], l);
+        int size1 = s->size[r1*BATCH_LANES + l];
+        int size2 = s->size[r2*BATCH_LANES + l];
+        int merged = size1;
+
+        if (r1 != r2) {
+            merged = size1 + size2;
+            if (size1 >= size2) {
+                s->size[r1*BATCH_LANES + l] = merged;
+                s->p[r2*BATCH_LANES + l] = r1;
+            }
+            else {
+                s->size[r2*BATCH_LANES + l] = merged;
+                s->p[r1*BATCH_LANES + l] = r2;
+            }
+        }
+        if (merged > limit) exceeded |= 1u << l;
+    }
+    return exceeded;
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Struct-of-arrays variant of set_union that holds BATCH_LANES independent
+ * sets at once, one per vector lane. Element x of lane l lives at
+ * p[x*BATCH_LANES + l], so the same element of every lane is contiguous and
+ * all lanes can be read with a single gather.
+ *
+ * p and size point to buffers of at least n*BATCH_LANES elements owned by
+ * the caller, eg. carved out of an arena.
+ *
+ * Uses AVX-512 when compiled with -mavx512f, AVX2 when compiled with -mavx2,
+ * and a plain loop over the lanes otherwise.
+ */
+#if defined(__AVX512F__)
+#define BATCH_LANES 16
+#else
+#define BATCH_LANES 8
+#endif
+
+typedef struct {
+    int* p;    // parent element of each lane
+    int* size; // num of elements in subtree i of each lane
+    int n;     // num of elements in each set
+} set_union_batch;
+
+void set_union_batch_init(set_union_batch* s, int n);
+
+/*
+ * Merges element s1 with element s2[l] in every lane l.
+ * Returns a bitmask with bit l set if the merged set of lane l
+ * holds more than "limit" elements.
+ */
+unsigned int union_set_batch(set_union_batch* s, int s1, const int* s2, int limit);
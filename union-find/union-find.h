@@ -1,10 +1,56 @@
+/*
+ * p and size point to buffers of at least n elements owned by the caller,
+ * eg. carved out of an arena, so that the set can be reused across
+ * simulations of any size without allocating.
+ */
 typedef struct {
-    int p[100];    // parent element
-    int size[100]; // num of elements in subtree i
-    int n;           // num of elements in set
+    int* p;    // parent element
+    int* size; // num of elements in subtree i
+    int n;     // num of elements in set
 } set_union;
 
 void set_union_init(set_union* s, int n);
 int find(set_union* s, int x);
 void union_set(set_union* s, int s1, int s2);
 unsigned char same_component(set_union* s, int s1, int s2);
+
+/*
+ * Inline versions of the functions above, for simulation kernels that know
+ * n at compile time and want the loops unrolled and the bounds folded.
+ */
+static inline void set_union_init_inline(set_union* s, int n) {
+    for (int i=0; i<n; i++) {
+        s->p[i] = i;
+        s->size[i] = 1;
+    }
+    s->n = n;
+}
+
+static inline int find_inline(set_union* s, int x) {
+    while (s->p[x] != x) {
+        s->p[x] = s->p[s->p[x]]; // semi-path compression
+        x = s->p[x];
+    }
+    return x;
+}
+
+/*
+ * Returns the size of the set that holds s1 and s2 after merging them.
+ */
+static inline int union_set_inline(set_union* s, int s1, int s2) {
+    int r1 = find_inline(s, s1);
+    int r2 = find_inline(s, s2);
+
+    if (r1 == r2) return s->size[r1];
+
+    if (s->size[r1] >= s->size[r2]) {
+        s->size[r1] = s->size[r1] + s->size[r2];
+        s->p[r2] = r1;
+        return s->size[r1];
+    }
+    else {
+        s->size[r2] = s->size[r1] + s->size[r2];
+        s->p[r1] = r2;
+        return s->size[r2];
+    }
+}